@@ -0,0 +1,78 @@
+//! Benchmarks of the tree operations on the layout path, at 4, 64 and 1024 windows.
+//!
+//! Run with `cargo bench --bench layout`.
+
+use criterion::{black_box, criterion_group, criterion_main, BatchSize, BenchmarkId, Criterion};
+use pengwm_daemon::core::bsp::BspTree;
+use pengwm_daemon::core::geometry::{Point, Rect, Size};
+use pengwm_daemon::core::layout::Bsp;
+use pengwm_daemon::core::types::WindowId;
+
+/// Window counts benchmarked: a typical workspace, a busy one and a stress case.
+const WINDOW_COUNTS: [u32; 3] = [4, 64, 1024];
+
+/// The area laid out, a common display size.
+fn workspace() -> Rect {
+    Rect::new(Point::new(0, 0), Size::new(2560, 1440))
+}
+
+/// Builds a tree of `count` tiled windows, each opened while the previous one had focus.
+fn tree(count: u32) -> BspTree {
+    let mut tree = BspTree::new();
+    for window in 1..=count {
+        let focused = tree.find_window(WindowId(window - 1));
+        tree.insert_window(WindowId(window), focused, count as usize + 1, &Bsp);
+    }
+    tree
+}
+
+/// A full layout pass over every tile, as after a display change.
+fn calculate_layout(c: &mut Criterion) {
+    let mut group = c.benchmark_group("calculate_layout");
+    for count in WINDOW_COUNTS {
+        let tree = tree(count);
+        group.bench_with_input(BenchmarkId::from_parameter(count), &tree, |b, tree| {
+            b.iter(|| tree.calculate_layout(black_box(workspace()), 8, 12));
+        });
+    }
+    group.finish();
+}
+
+/// Opening one more window next to the most recent one.
+fn insert_window(c: &mut Criterion) {
+    let mut group = c.benchmark_group("insert_window");
+    for count in WINDOW_COUNTS {
+        let window = WindowId(count + 1);
+        group.bench_function(BenchmarkId::from_parameter(count), |b| {
+            b.iter_batched(
+                || tree(count),
+                |mut tree| {
+                    let focused = tree.find_window(WindowId(count));
+                    tree.insert_window(black_box(window), focused, count as usize + 1, &Bsp);
+                    tree
+                },
+                BatchSize::SmallInput,
+            );
+        });
+    }
+    group.finish();
+}
+
+/// Looking up a managed window and one the tree does not hold, as every event does.
+fn contains_window(c: &mut Criterion) {
+    let mut group = c.benchmark_group("contains_window");
+    for count in WINDOW_COUNTS {
+        let tree = tree(count);
+        group.bench_with_input(BenchmarkId::from_parameter(count), &tree, |b, tree| {
+            b.iter(|| {
+                let managed = tree.contains_window(black_box(WindowId(count / 2 + 1)));
+                let unknown = tree.contains_window(black_box(WindowId(0)));
+                (managed, unknown)
+            });
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, calculate_layout, insert_window, contains_window);
+criterion_main!(benches);
@@ -0,0 +1,115 @@
+//! Replays a recorded event stream against the mock backend and reports the manager's
+//! throughput and latency.
+//!
+//! Usage: `replay <recording> [--latency-us N] [--fast]`
+//!
+//! Events are queued at their recorded times, or all at once with `--fast`. Every frame
+//! call of the mock backend takes `--latency-us` microseconds (default 0), standing in for
+//! the time real applications take to move a window.
+
+use pengwm_daemon::platform::mock::MockBackend;
+use pengwm_daemon::core::manager::WindowManager;
+use pengwm_daemon::core::metrics::{metrics, HistogramSnapshot};
+use pengwm_daemon::core::recording::Recording;
+use pengwm_daemon::config::Config;
+use pengwm_daemon::ipc::{self, IpcCommand, IpcServer, PendingCommand};
+use pengwm_daemon::core::queue;
+use anyhow::Context;
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+use tokio::sync::oneshot;
+
+/// Parsed command line.
+struct Options {
+    /// The recording to replay.
+    path: String,
+    /// Time taken by each frame call of the mock backend.
+    latency: Duration,
+    /// Queue every event immediately instead of at its recorded time.
+    fast: bool,
+}
+
+impl Options {
+    /// Reads the options from the process arguments.
+    fn parse() -> anyhow::Result<Self> {
+        let mut path = None;
+        let mut latency = Duration::ZERO;
+        let mut fast = false;
+        let mut args = std::env::args().skip(1);
+        while let Some(arg) = args.next() {
+            match arg.as_str() {
+                "--fast" => fast = true,
+                "--latency-us" => {
+                    let value = args.next().context("--latency-us needs a value")?;
+                    latency = Duration::from_micros(value.parse().context("invalid --latency-us")?);
+                }
+                _ if path.is_none() && !arg.starts_with("--") => path = Some(arg),
+                _ => anyhow::bail!("unexpected argument {:?}", arg),
+            }
+        }
+        let path = path.context("usage: replay <recording> [--latency-us N] [--fast]")?;
+        Ok(Self { path, latency, fast })
+    }
+}
+
+#[tokio::main]
+async fn main() -> anyhow::Result<()> {
+    env_logger::init();
+    let options = Options::parse()?;
+    let recording = Recording::load(&options.path).with_context(|| format!("cannot read {}", options.path))?;
+    if recording.monitors.is_empty() {
+        anyhow::bail!("{} has no displays line", options.path);
+    }
+
+    let backend = Arc::new(MockBackend::new(recording.monitors.clone(), options.latency));
+    let (event_tx, event_rx) = queue::event_queue();
+    let (command_tx, command_rx) = ipc::command_channel();
+    // Nothing listens on the server; it only receives the manager's broadcasts.
+    let ipc_server = Arc::new(IpcServer::new(command_tx.clone()));
+
+    let mut wm = WindowManager::new(backend.clone(), Config::load(), ipc_server);
+    tokio::spawn(async move {
+        wm.run(event_rx, command_rx).await;
+    });
+
+    let started = Instant::now();
+    let start = tokio::time::Instant::now();
+    for (at, event) in recording.events.iter().cloned() {
+        if !options.fast {
+            tokio::time::sleep_until(start + at).await;
+        }
+        event_tx.send(event);
+    }
+
+    // Answered once every event queued before it has been laid out and applied.
+    let (reply_tx, reply_rx) = oneshot::channel();
+    command_tx
+        .send(PendingCommand { command: IpcCommand::GetState, reply: reply_tx })
+        .await
+        .context("window manager stopped")?;
+    reply_rx.await.context("window manager stopped")?;
+    let elapsed = started.elapsed();
+
+    let events = recording.events.len();
+    let snapshot = metrics().snapshot();
+    println!("Replayed {} events from {}", events, options.path);
+    println!(
+        "  wall time     {:.3} s ({:.0} events/s)",
+        elapsed.as_secs_f64(),
+        events as f64 / elapsed.as_secs_f64().max(f64::EPSILON)
+    );
+    println!("  frame calls   {} ({} us each)", backend.frame_calls(), options.latency.as_micros());
+    print_histogram("event to frame", &snapshot.event_to_frame, "us");
+    print_histogram("layout", &snapshot.layout, "us");
+    print_histogram("apply frames", &snapshot.apply_frames, "us");
+    print_histogram("queue depth", &snapshot.queue_depth, "events");
+    Ok(())
+}
+
+/// Prints one line of the report.
+fn print_histogram(name: &str, histogram: &HistogramSnapshot, unit: &str) {
+    println!(
+        "  {:<13} n={} mean={} p50<={} p90<={} p99<={} max={} {}",
+        name, histogram.count, histogram.mean, histogram.p50, histogram.p90, histogram.p99, histogram.max, unit
+    );
+}
@@ -7,40 +7,73 @@ use std::path::Path;
 
 /// File system watcher for automatic configuration reloading.
 pub mod watcher;
+/// Per-application float/tile/ignore rules.
+pub mod rules;
+
+use crate::core::layout::LayoutKind;
+use rules::Rule;
+
+/// The configuration file, relative to the working directory.
+pub const CONFIG_FILE: &str = "config.toml";
 
 /// Global configuration for the window manager.
-#[derive(Debug, Clone, Serialize, Deserialize)]
+/// Settings missing from `config.toml` fall back to their defaults.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+#[serde(default)]
 pub struct Config {
     /// Maximum number of tiles per workspace.
     pub max_tiles: usize,
+    /// Number of workspaces on each display. Read at startup.
+    pub workspaces: usize,
+    /// The layout algorithm of workspaces without an entry in `workspace_layouts`.
+    pub layout: LayoutKind,
+    /// The layout algorithm of each workspace, by index.
+    pub workspace_layouts: Vec<LayoutKind>,
     /// Margin between windows and the monitor edge.
     pub gap_outer: i32,
     /// Margin between adjacent windows.
     pub gap_inner: i32,
+    /// How long to wait for more events before running a layout pass, in milliseconds.
+    pub debounce_ms: u64,
+    /// Per-application rules, compiled into a `rules::RuleSet` when loaded.
+    pub rules: Vec<Rule>,
 }
 
 impl Config {
     /// Loads configuration from the standard `config.toml` file.
-    /// If the file doesn't exist, it returns the default configuration.
+    /// If the file doesn't exist or is invalid, it returns the default configuration.
     pub fn load() -> Self {
-        let path = Path::new("config.toml");
-        if path.exists() {
-            match fs::read_to_string(path) {
-                Ok(content) => {
-                    match toml::from_str(&content) {
-                        Ok(config) => {
-                            log::info!("Loaded configuration from config.toml");
-                            return config;
-                        },
-                        Err(e) => log::error!("Failed to parse config.toml: {}", e),
-                    }
-                }
-                Err(e) => log::error!("Failed to read config.toml: {}", e),
+        match Self::try_load() {
+            Ok(config) => config,
+            Err(e) => {
+                log::error!("{}", e);
+                log::info!("Using default configuration");
+                Self::default()
             }
         }
-        
-        log::info!("Using default configuration");
-        Self::default()
+    }
+
+    /// Loads configuration from `config.toml`, falling back to the defaults only if the
+    /// file doesn't exist. Used when reloading, so a half-written file keeps the current settings.
+    pub fn try_load() -> Result<Self, String> {
+        let path = Path::new(CONFIG_FILE);
+        if !path.exists() {
+            log::info!("No {} found, using default configuration", CONFIG_FILE);
+            return Ok(Self::default());
+        }
+        let content = fs::read_to_string(path).map_err(|e| format!("Failed to read {}: {}", CONFIG_FILE, e))?;
+        let config = toml::from_str(&content).map_err(|e| format!("Failed to parse {}: {}", CONFIG_FILE, e))?;
+        log::info!("Loaded configuration from {}", CONFIG_FILE);
+        Ok(config)
+    }
+}
+
+impl Config {
+    /// Returns the layout algorithm of every workspace, by index.
+    pub fn layouts(&self) -> Vec<LayoutKind> {
+        (0..self.workspaces.max(1))
+            .map(|workspace| self.workspace_layouts.get(workspace).copied().unwrap_or(self.layout))
+            .collect()
     }
 }
 
@@ -49,8 +82,13 @@ impl Default for Config {
     fn default() -> Self {
         Self {
             max_tiles: 4,
+            workspaces: 4,
+            layout: LayoutKind::Bsp,
+            workspace_layouts: Vec::new(),
             gap_outer: 10,
             gap_inner: 5,
+            debounce_ms: 8,
+            rules: Vec::new(),
         }
     }
 }
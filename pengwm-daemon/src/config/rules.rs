@@ -0,0 +1,144 @@
+//! Per-application window rules.
+//!
+//! `[[rules]]` entries are compiled once, when the configuration is loaded, into a `RuleSet`:
+//! bundle ids and app names become hash lookups and every title pattern goes into a single
+//! `RegexSet`, so evaluating a window costs two lookups and one regex scan of its title.
+
+use regex::{Regex, RegexSet};
+use serde::{Serialize, Deserialize};
+use std::collections::HashMap;
+
+/// What to do with a window matched by a rule.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+#[serde(rename_all = "lowercase")]
+pub enum RuleAction {
+    /// Manage the window but leave it out of the tiling layout.
+    Float,
+    /// Tile the window even if the backend's heuristics would skip it.
+    Tile,
+    /// Do not manage the window at all.
+    Ignore,
+}
+
+/// A `[[rules]]` entry. Every criterion given must match; a rule without criteria matches
+/// every window. When several rules match, the first one in the file wins.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct Rule {
+    /// The application's bundle identifier, e.g. `com.apple.finder`. macOS only.
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub bundle_id: Option<String>,
+    /// The application's name: its localized name on macOS, its executable name on Windows.
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub app: Option<String>,
+    /// A regular expression searched for in the window title.
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub title: Option<String>,
+    /// What to do with matching windows.
+    pub action: RuleAction,
+}
+
+/// The attributes of a window that rules can match on.
+#[derive(Debug, Clone, Copy, Default)]
+pub struct RuleSubject<'a> {
+    /// The owning application's bundle identifier, if it has one.
+    pub bundle_id: Option<&'a str>,
+    /// The owning application's name.
+    pub app: Option<&'a str>,
+    /// The window title when the window appeared.
+    pub title: Option<&'a str>,
+}
+
+/// A compiled matcher for a list of rules.
+#[derive(Debug, Default)]
+pub struct RuleSet {
+    /// Action and title pattern (index into `titles`) of each rule, in file order.
+    rules: Vec<(RuleAction, Option<usize>)>,
+    /// Rules keyed by bundle id, in file order.
+    by_bundle_id: HashMap<String, Vec<usize>>,
+    /// Rules keyed by app name, in file order.
+    by_app: HashMap<String, Vec<usize>>,
+    /// Rules that name neither a bundle id nor an app, in file order.
+    any_app: Vec<usize>,
+    /// The app named by rules that also name a bundle id; both must match.
+    app_of: HashMap<usize, String>,
+    /// Every title pattern, compiled together.
+    titles: RegexSet,
+}
+
+impl RuleSet {
+    /// Compiles `rules`. Rules with an invalid title pattern are logged and skipped.
+    pub fn compile(rules: &[Rule]) -> Self {
+        let mut set = Self::default();
+        let mut patterns = Vec::new();
+        for rule in rules {
+            let pattern = match &rule.title {
+                Some(title) => match Regex::new(title) {
+                    Ok(_) => {
+                        patterns.push(title.as_str());
+                        Some(patterns.len() - 1)
+                    }
+                    Err(e) => {
+                        log::error!("Skipping rule with invalid title pattern {:?}: {}", title, e);
+                        continue;
+                    }
+                },
+                None => None,
+            };
+            let index = set.rules.len();
+            set.rules.push((rule.action, pattern));
+            match (&rule.bundle_id, &rule.app) {
+                (Some(bundle_id), app) => {
+                    set.by_bundle_id.entry(bundle_id.clone()).or_default().push(index);
+                    if let Some(app) = app {
+                        set.app_of.insert(index, app.clone());
+                    }
+                }
+                (None, Some(app)) => set.by_app.entry(app.clone()).or_default().push(index),
+                (None, None) => set.any_app.push(index),
+            }
+        }
+        // Every pattern compiled on its own above, so the set compiles too.
+        set.titles = RegexSet::new(patterns).unwrap_or_else(|_| RegexSet::empty());
+        log::info!("Compiled {} window rule(s)", set.rules.len());
+        set
+    }
+
+    /// Checks if there are no rules to evaluate.
+    pub fn is_empty(&self) -> bool {
+        self.rules.is_empty()
+    }
+
+    /// Returns the action of the first rule matching `subject`.
+    pub fn evaluate(&self, subject: RuleSubject) -> Option<RuleAction> {
+        if self.is_empty() {
+            return None;
+        }
+        let mut candidates: Vec<usize> = lookup(&self.by_bundle_id, subject.bundle_id)
+            .iter()
+            .filter(|index| self.app_of.get(index).map_or(true, |app| subject.app == Some(app.as_str())))
+            .chain(lookup(&self.by_app, subject.app))
+            .chain(&self.any_app)
+            .copied()
+            .collect();
+        if candidates.is_empty() {
+            return None;
+        }
+        candidates.sort_unstable();
+
+        // Only scan the title if a candidate has a pattern.
+        let mut matches = None;
+        candidates.into_iter().find_map(|index| {
+            let (action, pattern) = self.rules[index];
+            let Some(pattern) = pattern else {
+                return Some(action);
+            };
+            let matches = matches.get_or_insert_with(|| self.titles.matches(subject.title.unwrap_or("")));
+            matches.matched(pattern).then_some(action)
+        })
+    }
+}
+
+/// Returns the rules filed under `key`, or none if there is no key.
+fn lookup<'a>(map: &'a HashMap<String, Vec<usize>>, key: Option<&str>) -> &'a [usize] {
+    key.and_then(|key| map.get(key)).map(Vec::as_slice).unwrap_or(&[])
+}
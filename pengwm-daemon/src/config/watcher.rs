@@ -1,7 +1,67 @@
 //! File system watcher for the PengWM configuration.
 //!
-//! This module will use the `notify` crate to watch for changes to the 
-//! `config.toml` file and automatically trigger a layout update when 
-//! settings like gaps or tile counts are modified.
+//! Watches the directory holding `config.toml` (editors often replace the file rather than
+//! write it in place) and, once a burst of changes has settled, asks the Window Manager to
+//! reload it through the same command queue IPC clients use.
 
-// TODO: Implement notify file watcher.
+use crate::config::CONFIG_FILE;
+use crate::ipc::{IpcCommand, IpcReply, PendingCommand};
+use notify::{Event, EventKind, RecommendedWatcher, RecursiveMode, Watcher};
+use std::path::Path;
+use std::time::Duration;
+use tokio::sync::{mpsc, oneshot};
+
+/// How long the file must stay unchanged before it is reloaded.
+const RELOAD_DEBOUNCE: Duration = Duration::from_millis(200);
+
+/// Keeps the file system watch alive; dropping it stops automatic reloading.
+pub struct ConfigWatcher {
+    _watcher: RecommendedWatcher,
+}
+
+impl ConfigWatcher {
+    /// Starts watching `config.toml`, sending a `ReloadConfig` command to `commands` after
+    /// each change. Must be called from within the Tokio runtime.
+    pub fn spawn(commands: mpsc::Sender<PendingCommand>) -> notify::Result<Self> {
+        // A change while a reload is already pending needs no second signal.
+        let (changed_tx, changed_rx) = mpsc::channel(1);
+        let mut watcher = notify::recommended_watcher(move |result: notify::Result<Event>| match result {
+            Ok(event) if is_config_change(&event) => {
+                let _ = changed_tx.try_send(());
+            }
+            Ok(_) => {}
+            Err(e) => log::warn!("Config watcher error: {}", e),
+        })?;
+        watcher.watch(Path::new("."), RecursiveMode::NonRecursive)?;
+        tokio::spawn(reload_on_change(changed_rx, commands));
+        log::info!("Watching {} for changes", CONFIG_FILE);
+        Ok(Self { _watcher: watcher })
+    }
+}
+
+/// Checks if an event touches the configuration file's contents.
+fn is_config_change(event: &Event) -> bool {
+    matches!(event.kind, EventKind::Create(_) | EventKind::Modify(_) | EventKind::Remove(_))
+        && event.paths.iter().any(|path| path.file_name().is_some_and(|name| name == CONFIG_FILE))
+}
+
+/// Sends one `ReloadConfig` per settled burst of changes until the manager goes away.
+async fn reload_on_change(mut changed: mpsc::Receiver<()>, commands: mpsc::Sender<PendingCommand>) {
+    while changed.recv().await.is_some() {
+        // A single save is often several writes, or a rename over the old file.
+        loop {
+            tokio::time::sleep(RELOAD_DEBOUNCE).await;
+            if changed.try_recv().is_err() {
+                break;
+            }
+        }
+        let (reply_tx, reply_rx) = oneshot::channel();
+        let reload = PendingCommand { command: IpcCommand::ReloadConfig, reply: reply_tx };
+        if commands.send(reload).await.is_err() {
+            break;
+        }
+        if let Ok(IpcReply::Error(e)) = reply_rx.await {
+            log::error!("Keeping the current configuration: {}", e);
+        }
+    }
+}
@@ -4,7 +4,26 @@
 use serde::{Serialize, Deserialize};
 use crate::core::types::WindowId;
 use crate::core::geometry::Rect;
+use crate::core::layout::{split_rect, Layout, Ratio};
+use crate::core::layout_cache::{LayoutCache, LayoutParams};
 use indextree::NodeId;
+use smallvec::SmallVec;
+use std::collections::{HashMap, HashSet};
+
+/// Arenas smaller than this are never worth compacting.
+const COMPACT_MIN_NODES: usize = 64;
+
+/// Background windows of a tile. Most tiles hold only a few, which stay inline in the node.
+pub type WindowStack = SmallVec<[WindowId; 3]>;
+
+/// Which way `BspTree::cycle_stack` rotates a tile's windows.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub enum CycleDirection {
+    /// Show the most recently stacked window; the visible one goes to the back.
+    Forward,
+    /// Show the window at the back; the visible one goes on top of the stack.
+    Backward,
+}
 
 /// Represents the axis along which a node is split.
 #[derive(Debug, Clone, Copy, Serialize, Deserialize)]
@@ -22,24 +41,60 @@ pub enum NodeData {
     Split {
         /// The axis of the split.
         axis: SplitAxis,
-        /// The ratio of the split (0.0 to 1.0).
-        ratio: f32,
+        /// The share of the split's area given to the first child.
+        ratio: Ratio,
     },
     /// A leaf node that contains one or more windows.
     Leaf {
         /// The window currently visible in this tile.
         visible_window: Option<WindowId>,
-        /// Background windows stacked behind the visible one.
-        stack: Vec<WindowId>,
+        /// Background windows stacked behind the visible one; the last is the most recent.
+        stack: WindowStack,
     },
 }
 
+impl NodeData {
+    /// An empty leaf, used for nodes sitting in the free list.
+    fn vacant() -> Self {
+        NodeData::Leaf { visible_window: None, stack: WindowStack::new() }
+    }
+}
+
+/// Summary counters describing the shape of a tree, maintained incrementally.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct TreeStats {
+    /// Number of tiles (leaf nodes).
+    pub leaves: usize,
+    /// Total number of managed windows, visible or stacked.
+    pub windows: usize,
+    /// Number of windows stacked behind a visible one.
+    pub stacked: usize,
+    /// Length of the longest root-to-leaf path.
+    pub depth: usize,
+    /// Number of nodes allocated in the arena, including recycled ones.
+    pub arena_nodes: usize,
+    /// Number of nodes currently attached to the tree.
+    pub live_nodes: usize,
+}
+
 /// The BSP tree structure using an arena-based tree representation.
 pub struct BspTree {
     /// The arena where all nodes are stored.
     pub arena: indextree::Arena<NodeData>,
     /// The root node of the tree.
     pub root: Option<NodeId>,
+    /// Maps every managed window (visible or stacked) to the leaf holding it.
+    index: HashMap<WindowId, NodeId>,
+    /// Number of leaf nodes currently in the tree.
+    leaf_count: usize,
+    /// Number of windows stacked behind a visible one, across all leaves.
+    stacked: usize,
+    /// Number of leaves at each depth, so the tree depth is known without walking it.
+    leaf_depths: Vec<usize>,
+    /// Rectangles from the previous layout pass and the subtrees that changed since.
+    layout: LayoutCache,
+    /// Detached nodes waiting to be reused by the next split.
+    free: Vec<NodeId>,
 }
 
 impl BspTree {
@@ -48,70 +103,206 @@ impl BspTree {
         Self {
             arena: indextree::Arena::new(),
             root: None,
+            index: HashMap::new(),
+            leaf_count: 0,
+            stacked: 0,
+            leaf_depths: Vec::new(),
+            layout: LayoutCache::new(),
+            free: Vec::new(),
         }
     }
 
     /// Checks if a window is already managed by this tree.
-    fn any_descendants_satisfy<F>(&self, node_id: NodeId, condition: F) -> bool
-    where
-        F: Fn(&NodeData) -> bool,
-    {
-        if let Some(node) = self.arena.get(node_id) {
-            condition(&node.get())
-        } else {
-            false
-        }
+    pub fn contains_window(&self, window: WindowId) -> bool {
+        self.index.contains_key(&window)
     }
 
-    pub fn contains_window(&self, window: WindowId) -> bool {
-        self.root.as_ref().map_or(false, |root| {
-            root.descendants(&self.arena).any(|id| {
-                self.any_descendants_satisfy(id, |node| {
-                    if let NodeData::Leaf { visible_window, stack } = node {
-                        visible_window == &Some(window) || stack.contains(&window)
-                    } else {
-                        false
-                    }
-                })
-            })
-        })
+    /// Returns the leaf node that holds the given window, if it is managed.
+    pub fn find_window(&self, window: WindowId) -> Option<NodeId> {
+        self.index.get(&window).copied()
+    }
+
+    /// Returns every managed window, visible or stacked, in no particular order.
+    pub fn windows(&self) -> impl Iterator<Item = WindowId> + '_ {
+        self.index.keys().copied()
     }
 
+    /// Returns the window currently visible in a leaf.
+    pub fn visible_window(&self, leaf: NodeId) -> Option<WindowId> {
+        match self.arena.get(leaf).map(|node| node.get()) {
+            Some(NodeData::Leaf { visible_window, .. }) => *visible_window,
+            _ => None,
+        }
+    }
+
+    /// Returns the number of windows stacked behind the tile holding `window`.
+    pub fn stack_size(&self, window: WindowId) -> usize {
+        match self.find_window(window).map(|id| self.arena[id].get()) {
+            Some(NodeData::Leaf { stack, .. }) => stack.len(),
+            _ => 0,
+        }
+    }
 
     /// Count the number of active leaf nodes in the tree.
     pub fn count_leaves(&self) -> usize {
-        if let Some(root) = self.root {
-            root.descendants(&self.arena)
-                .filter(|id| {
-                    matches!(self.arena.get(*id).map(|n| n.get()), Some(NodeData::Leaf { .. }))
-                })
-                .count()
-        } else {
-            0
+        self.leaf_count
+    }
+
+    /// Returns the current shape counters of the tree.
+    pub fn stats(&self) -> TreeStats {
+        TreeStats {
+            leaves: self.leaf_count,
+            windows: self.index.len(),
+            stacked: self.stacked,
+            depth: self.leaf_depths.len().saturating_sub(1),
+            arena_nodes: self.arena.count(),
+            live_nodes: self.arena.count() - self.free.len(),
+        }
+    }
+
+    /// Whether enough nodes sit unused in the free list to make `compact` worthwhile.
+    pub fn needs_compaction(&self) -> bool {
+        self.arena.count() >= COMPACT_MIN_NODES && self.free.len() > self.arena.count() / 2
+    }
+
+    /// Rebuilds the arena with only the live nodes, in depth-first order.
+    ///
+    /// Drops the free list, so memory follows the current tree size rather than its peak,
+    /// and places each subtree contiguously for layout traversal. Node IDs change; the
+    /// window index and the layout cache are rewritten to match.
+    pub fn compact(&mut self) {
+        let Some(root) = self.root else {
+            self.arena = indextree::Arena::new();
+            self.free.clear();
+            return;
+        };
+
+        let order: Vec<NodeId> = root.descendants(&self.arena).collect();
+        let mut arena = indextree::Arena::with_capacity(order.len());
+        let mut remap: HashMap<NodeId, NodeId> = HashMap::with_capacity(order.len());
+        // Pre-order visits parents before children and children in order, so appending
+        // reproduces the tree exactly.
+        for old in order {
+            let data = std::mem::replace(self.arena[old].get_mut(), NodeData::vacant());
+            let new = arena.new_node(data);
+            if let Some(parent) = self.arena[old].parent() {
+                remap[&parent].append(new, &mut arena);
+            }
+            remap.insert(old, new);
+        }
+
+        self.arena = arena;
+        self.root = Some(remap[&root]);
+        self.free.clear();
+        for leaf in self.index.values_mut() {
+            *leaf = remap[leaf];
+        }
+        self.layout.remap_nodes(&remap);
+    }
+
+    /// Returns the tree's nodes in pre-order, the form `restore` reads back.
+    pub fn saved_nodes(&self) -> Vec<NodeData> {
+        let Some(root) = self.root else {
+            return Vec::new();
+        };
+        root.descendants(&self.arena).map(|id| self.arena[id].get().clone()).collect()
+    }
+
+    /// Rebuilds a tree from nodes saved by `saved_nodes`, replacing each saved window with
+    /// the window `window` maps it to. Unmapped windows are dropped, and so are the tiles and
+    /// splits they leave empty. The whole tree is marked dirty.
+    pub fn restore(nodes: &[NodeData], mut window: impl FnMut(WindowId) -> Option<WindowId>) -> Self {
+        let mut tree = Self::new();
+        tree.root = tree.restore_node(&mut nodes.iter(), &mut window);
+        let Some(root) = tree.root else {
+            return tree;
+        };
+        let leaves: Vec<(usize, usize)> = root
+            .descendants(&tree.arena)
+            .filter_map(|id| match tree.arena[id].get() {
+                NodeData::Leaf { stack, .. } => Some((tree.depth_of(id), stack.len())),
+                NodeData::Split { .. } => None,
+            })
+            .collect();
+        for (depth, stacked) in leaves {
+            tree.add_leaf_depth(depth);
+            tree.leaf_count += 1;
+            tree.stacked += stacked;
+        }
+        tree.layout.mark_dirty(root);
+        tree
+    }
+
+    /// Rebuilds the next saved subtree; `None` if none of its windows were mapped.
+    fn restore_node(
+        &mut self,
+        nodes: &mut std::slice::Iter<'_, NodeData>,
+        window: &mut impl FnMut(WindowId) -> Option<WindowId>,
+    ) -> Option<NodeId> {
+        match nodes.next()? {
+            NodeData::Split { axis, ratio } => {
+                // Both children are read even if the first is empty, to stay in step.
+                let first = self.restore_node(nodes, window);
+                let second = self.restore_node(nodes, window);
+                match (first, second) {
+                    (Some(first), Some(second)) => {
+                        let ratio = (*ratio).clamp(Ratio::MIN, Ratio::MAX);
+                        let node = self.arena.new_node(NodeData::Split { axis: *axis, ratio });
+                        node.append(first, &mut self.arena);
+                        node.append(second, &mut self.arena);
+                        Some(node)
+                    }
+                    (only, None) | (None, only) => only,
+                }
+            }
+            NodeData::Leaf { visible_window, stack } => {
+                // A corrupt file could list a window twice; it is kept where it first appears.
+                let mut windows = WindowStack::new();
+                for live in stack.iter().chain(visible_window).filter_map(|&saved| window(saved)) {
+                    if !self.index.contains_key(&live) && !windows.contains(&live) {
+                        windows.push(live);
+                    }
+                }
+                // The visible window comes last, so the most recent stacked one replaces it
+                // if it is gone.
+                let visible = windows.pop()?;
+                let node = self.arena.new_node(NodeData::vacant());
+                for &win in windows.iter().chain(std::iter::once(&visible)) {
+                    self.index.insert(win, node);
+                }
+                *self.arena[node].get_mut() = NodeData::Leaf { visible_window: Some(visible), stack: windows };
+                Some(node)
+            }
         }
     }
 
     /// Insert a window into the tree at the specified focused node, respecting max_tiles.
-    /// If max_tiles is reached, the window is stacked behind the currently visible one.
+    /// If max_tiles is reached, the window is stacked behind the currently visible one;
+    /// otherwise the tile is split the way `layout` chooses for its current rectangle.
     pub fn insert_window(
         &mut self,
         window: WindowId,
         focused_node: Option<NodeId>,
         max_tiles: usize,
+        layout: &dyn Layout,
     ) -> NodeId {
         let current_leaves = self.count_leaves();
 
         // Scenario: Empty tree - create the root leaf.
         if self.root.is_none() {
-            let node = self.arena.new_node(NodeData::Leaf {
+            let node = self.alloc_node(NodeData::Leaf {
                 visible_window: Some(window),
-                stack: Vec::new(),
+                stack: WindowStack::new(),
             });
             self.root = Some(node);
+            self.index.insert(window, node);
+            self.leaf_count = 1;
+            self.add_leaf_depth(0);
+            self.layout.mark_dirty(node);
             return node;
         }
 
-        let target_node = focused_node.unwrap_or(self.root.unwrap());
+        let target_node = self.resolve_leaf(focused_node.unwrap_or(self.root.unwrap()));
 
         // Scenario B: At Limit - Overflow Strategy: Stacking in the current tile.
         if current_leaves >= max_tiles {
@@ -123,40 +314,343 @@ impl BspTree {
                 {
                     if let Some(prev_window) = visible_window.replace(window) {
                         stack.push(prev_window);
+                        self.stacked += 1;
+                        self.layout.forget_window(prev_window);
                     }
+                    self.index.insert(window, target_node);
+                    self.layout.mark_dirty(target_node);
                     return target_node;
                 }
             }
         }
 
         // Scenario A: Under Limit - Standard BSP split of the current leaf.
-        let old_data = {
-            let node_ref = self.arena.get_mut(target_node).expect("Target node exists");
-            let data = node_ref.get().clone();
-            
-            // Choose split axis based on the current aspect ratio or toggle (default horizontal).
-            // This could be made smarter by taking the node's rectangle as input.
-            *node_ref.get_mut() = NodeData::Split {
-                axis: SplitAxis::Horizontal,
-                ratio: 0.5,
-            };
-            data
-        };
+        // The leaf's contents are moved out, not cloned, and become the left child.
+        let axis = layout.split_axis(self.split_rect_of(target_node));
+        let old_data = std::mem::replace(
+            self.arena[target_node].get_mut(),
+            NodeData::Split { axis, ratio: Ratio::HALF },
+        );
 
         // Create two new leaves: one with the old content, one with the new window.
-        let left_child = self.arena.new_node(old_data);
-        let right_child = self.arena.new_node(NodeData::Leaf {
+        let left_child = self.alloc_node(old_data);
+        let right_child = self.alloc_node(NodeData::Leaf {
             visible_window: Some(window),
-            stack: Vec::new(),
+            stack: WindowStack::new(),
         });
 
         // Attach children to the previously leaf-now-split node.
         target_node.append(left_child, &mut self.arena);
         target_node.append(right_child, &mut self.arena);
 
+        // The old content moved into the left child, so re-point its windows.
+        if let NodeData::Leaf { visible_window, stack } = self.arena[left_child].get() {
+            for win in visible_window.iter().chain(stack.iter()) {
+                self.index.insert(*win, left_child);
+            }
+        }
+        self.index.insert(window, right_child);
+
+        // One leaf at the target's depth became two leaves one level deeper.
+        let depth = self.depth_of(target_node);
+        self.remove_leaf_depth(depth);
+        self.add_leaf_depth(depth + 1);
+        self.add_leaf_depth(depth + 1);
+        self.leaf_count += 1;
+        self.layout.mark_dirty(target_node);
+
         right_child
     }
 
+    /// Removes a window from the tree, collapsing its tile if it was the last one in it.
+    /// Returns `false` if the window was not managed by this tree.
+    pub fn remove_window(&mut self, window: WindowId) -> bool {
+        let Some(leaf) = self.index.remove(&window) else {
+            return false;
+        };
+        self.layout.forget_window(window);
+
+        // Drop the window from its leaf, promoting the most recent stacked window if needed.
+        let now_empty = match self.arena[leaf].get_mut() {
+            NodeData::Leaf { visible_window, stack } => {
+                if *visible_window == Some(window) {
+                    *visible_window = stack.pop();
+                    if visible_window.is_some() {
+                        self.stacked -= 1;
+                        self.layout.mark_dirty(leaf);
+                    }
+                } else {
+                    stack.retain(|w| *w != window);
+                    self.stacked -= 1;
+                }
+                visible_window.is_none()
+            }
+            NodeData::Split { .. } => false,
+        };
+
+        if now_empty {
+            self.collapse_leaf(leaf);
+        }
+        true
+    }
+
+    /// Swaps the positions of two managed windows, whether visible or stacked.
+    /// Returns `false` if either window is not managed by this tree.
+    pub fn swap_windows(&mut self, a: WindowId, b: WindowId) -> bool {
+        let (Some(node_a), Some(node_b)) = (self.find_window(a), self.find_window(b)) else {
+            return false;
+        };
+
+        self.swap_in_leaf(node_a, a, b);
+        if node_a != node_b {
+            self.swap_in_leaf(node_b, a, b);
+        }
+        self.index.insert(a, node_b);
+        self.index.insert(b, node_a);
+
+        // Either window may have moved between visible and stacked, so re-place both.
+        self.layout.forget_window(a);
+        self.layout.forget_window(b);
+        self.layout.mark_dirty(node_a);
+        self.layout.mark_dirty(node_b);
+        true
+    }
+
+    /// Rotates the windows of the tile holding `window`, returning the newly visible window.
+    /// Works in place: the tile's window count never changes, so nothing is allocated.
+    pub fn cycle_stack(&mut self, window: WindowId, direction: CycleDirection) -> Option<WindowId> {
+        let leaf = self.find_window(window)?;
+        let NodeData::Leaf { visible_window, stack } = self.arena[leaf].get_mut() else {
+            return None;
+        };
+        let current = (*visible_window)?;
+        let next = match direction {
+            CycleDirection::Forward => {
+                let next = stack.pop()?;
+                stack.insert(0, current);
+                next
+            }
+            CycleDirection::Backward => {
+                if stack.is_empty() {
+                    return None;
+                }
+                let next = stack.remove(0);
+                stack.push(current);
+                next
+            }
+        };
+        *visible_window = Some(next);
+        self.replace_visible(leaf, current);
+        Some(next)
+    }
+
+    /// Makes a stacked window the visible one of its tile; the previously visible window
+    /// becomes the most recent entry of the stack. Returns `false` if `window` is not stacked.
+    pub fn promote_window(&mut self, window: WindowId) -> bool {
+        let Some(leaf) = self.find_window(window) else {
+            return false;
+        };
+        let NodeData::Leaf { visible_window, stack } = self.arena[leaf].get_mut() else {
+            return false;
+        };
+        let (Some(current), Some(pos)) = (*visible_window, stack.iter().position(|w| *w == window)) else {
+            return false;
+        };
+        // Reuse the promoted window's slot, then move the old visible window to the top.
+        stack[pos] = current;
+        stack[pos..].rotate_left(1);
+        *visible_window = Some(window);
+        self.replace_visible(leaf, current);
+        true
+    }
+
+    /// Moves `window` to the back of its tile's stack. If it was visible, the most recently
+    /// stacked window takes its place. Returns `false` if the tile holds no other window.
+    pub fn send_to_back(&mut self, window: WindowId) -> bool {
+        let Some(leaf) = self.find_window(window) else {
+            return false;
+        };
+        let NodeData::Leaf { visible_window, stack } = self.arena[leaf].get_mut() else {
+            return false;
+        };
+        if stack.is_empty() {
+            return false;
+        }
+        if *visible_window == Some(window) {
+            let next = stack.pop().expect("stack is not empty");
+            stack.insert(0, window);
+            *visible_window = Some(next);
+            self.replace_visible(leaf, window);
+        } else if let Some(pos) = stack.iter().position(|w| *w == window) {
+            stack[..=pos].rotate_right(1);
+        }
+        true
+    }
+
+    /// Changes the split ratio of the split containing `window`'s tile.
+    /// Only the two subtrees of that split are recomputed on the next layout pass.
+    pub fn set_ratio(&mut self, window: WindowId, ratio: Ratio) -> bool {
+        let Some(parent) = self.find_window(window).and_then(|leaf| self.arena[leaf].parent()) else {
+            return false;
+        };
+        if let NodeData::Split { ratio: current, .. } = self.arena[parent].get_mut() {
+            *current = ratio.clamp(Ratio::MIN, Ratio::MAX);
+        }
+        self.layout.mark_dirty(parent);
+        true
+    }
+
+    /// Re-applies the overflow strategy for a new tile limit.
+    ///
+    /// Above the limit, the windows of the last tile are stacked onto the tile before it;
+    /// below it, stacked windows are split back out into tiles of their own. Windows keep
+    /// their tiles otherwise. Returns `true` if any tile was added or removed.
+    pub fn reflow(&mut self, max_tiles: usize, layout: &dyn Layout) -> bool {
+        let max_tiles = max_tiles.max(1);
+        let mut changed = false;
+        while self.leaf_count > max_tiles {
+            let Some(leaf) = self.root.map(|root| self.resolve_leaf(root)) else {
+                break;
+            };
+            let NodeData::Leaf { visible_window, stack } = self.arena[leaf].get() else {
+                break;
+            };
+            // Visible window last, so it stays visible in its new tile.
+            let windows: WindowStack = stack.iter().copied().chain(*visible_window).collect();
+            for &window in &windows {
+                self.remove_window(window);
+            }
+            for window in windows {
+                self.insert_window(window, None, max_tiles, layout);
+            }
+            changed = true;
+        }
+        while self.leaf_count < max_tiles && self.stacked > 0 {
+            let Some((leaf, window)) = self.root.and_then(|root| {
+                root.descendants(&self.arena).find_map(|node| match self.arena[node].get() {
+                    NodeData::Leaf { stack, .. } => stack.last().map(|&window| (node, window)),
+                    NodeData::Split { .. } => None,
+                })
+            }) else {
+                break;
+            };
+            self.remove_window(window);
+            self.insert_window(window, Some(leaf), max_tiles, layout);
+            changed = true;
+        }
+        changed
+    }
+
+    /// Updates the layout cache after `previous` stopped being the visible window of `leaf`.
+    fn replace_visible(&mut self, leaf: NodeId, previous: WindowId) {
+        self.layout.forget_window(previous);
+        self.layout.mark_dirty(leaf);
+    }
+
+    /// Exchanges every occurrence of `a` and `b` within a single leaf.
+    fn swap_in_leaf(&mut self, node: NodeId, a: WindowId, b: WindowId) {
+        let swap = |w: &mut WindowId| {
+            if *w == a {
+                *w = b;
+            } else if *w == b {
+                *w = a;
+            }
+        };
+        if let NodeData::Leaf { visible_window, stack } = self.arena[node].get_mut() {
+            visible_window.iter_mut().for_each(swap);
+            stack.iter_mut().for_each(swap);
+        }
+    }
+
+    /// Removes an empty leaf and lets its sibling take over the parent's area.
+    fn collapse_leaf(&mut self, leaf: NodeId) {
+        self.remove_leaf_depth(self.depth_of(leaf));
+        self.leaf_count -= 1;
+        self.layout.forget_node(leaf);
+
+        let Some(parent) = self.arena[leaf].parent() else {
+            // The last tile in the tree has gone away.
+            self.free_node(leaf);
+            self.root = None;
+            return;
+        };
+
+        let sibling = parent
+            .children(&self.arena)
+            .find(|id| *id != leaf)
+            .expect("Split nodes have two children");
+
+        // The sibling subtree keeps its node ids, so the window index stays valid.
+        sibling.detach(&mut self.arena);
+        if self.root == Some(parent) {
+            self.root = Some(sibling);
+        } else {
+            parent.insert_after(sibling, &mut self.arena);
+        }
+        self.free_node(leaf);
+        self.free_node(parent);
+        self.layout.forget_node(parent);
+        self.layout.mark_dirty(sibling);
+
+        // Every leaf under the sibling moved one level closer to the root.
+        let moved: Vec<usize> = sibling
+            .descendants(&self.arena)
+            .filter(|id| matches!(self.arena[*id].get(), NodeData::Leaf { .. }))
+            .map(|id| self.depth_of(id))
+            .collect();
+        for depth in moved {
+            self.remove_leaf_depth(depth + 1);
+            self.add_leaf_depth(depth);
+        }
+    }
+
+    /// Creates a node, reusing a previously freed one if available.
+    fn alloc_node(&mut self, data: NodeData) -> NodeId {
+        match self.free.pop() {
+            Some(node) => {
+                *self.arena[node].get_mut() = data;
+                node
+            }
+            None => self.arena.new_node(data),
+        }
+    }
+
+    /// Detaches a node that is no longer part of the tree and keeps it for reuse.
+    fn free_node(&mut self, node: NodeId) {
+        node.detach(&mut self.arena);
+        *self.arena[node].get_mut() = NodeData::vacant();
+        self.free.push(node);
+    }
+
+    /// Returns the number of edges between `node` and the root.
+    fn depth_of(&self, node: NodeId) -> usize {
+        node.ancestors(&self.arena).count() - 1
+    }
+
+    /// Records a leaf at the given depth.
+    fn add_leaf_depth(&mut self, depth: usize) {
+        if self.leaf_depths.len() <= depth {
+            self.leaf_depths.resize(depth + 1, 0);
+        }
+        self.leaf_depths[depth] += 1;
+    }
+
+    /// Forgets a leaf at the given depth, trimming levels that no longer hold any leaves.
+    fn remove_leaf_depth(&mut self, depth: usize) {
+        self.leaf_depths[depth] -= 1;
+        while self.leaf_depths.last() == Some(&0) {
+            self.leaf_depths.pop();
+        }
+    }
+
+    /// Descends from `node` to a leaf, following the most recently inserted branch.
+    fn resolve_leaf(&self, mut node: NodeId) -> NodeId {
+        while let Some(child) = self.arena[node].last_child() {
+            node = child;
+        }
+        node
+    }
+
     /// Recursively calculate the rectangles for each visible window.
     pub fn calculate_layout(&self, root_rect: Rect, gap_inner: i32, gap_outer: i32) -> Vec<(WindowId, Rect)> {
         let mut layouts = Vec::new();
@@ -176,48 +670,299 @@ impl BspTree {
         gap_inner: i32,
         layouts: &mut Vec<(WindowId, Rect)>,
     ) {
-        let node = self.arena.get(node_id).expect("Node exists").get();
-        match node {
+        let node = &self.arena[node_id];
+        match node.get() {
             NodeData::Leaf { visible_window: Some(win), .. } => {
                 layouts.push((*win, rect));
             }
             NodeData::Split { axis, ratio } => {
-                let children: Vec<NodeId> = node_id.children(&self.arena).collect();
-                if children.len() == 2 {
-                    let (left_rect, right_rect) = self.split_rect(rect, *axis, *ratio, gap_inner);
-                    self.calculate_node_layout(children[0], left_rect, gap_inner, layouts);
-                    self.calculate_node_layout(children[1], right_rect, gap_inner, layouts);
+                if let (Some(first), Some(second)) = (node.first_child(), node.last_child()) {
+                    let (first_rect, second_rect) = split_rect(rect, *axis, *ratio, gap_inner);
+                    self.calculate_node_layout(first, first_rect, gap_inner, layouts);
+                    self.calculate_node_layout(second, second_rect, gap_inner, layouts);
+                }
+            }
+            _ => {}
+        }
+    }
+
+    /// Brings the cached layout up to date with `layout` and returns only the windows whose
+    /// rectangles changed.
+    ///
+    /// Nothing is computed unless tree mutations marked a subtree dirty since the previous
+    /// pass, or the display rectangle or the gaps changed, which recomputes everything.
+    pub fn update_layout(
+        &mut self,
+        layout: &dyn Layout,
+        root_rect: Rect,
+        gap_inner: i32,
+        gap_outer: i32,
+    ) -> Vec<(WindowId, Rect)> {
+        let Some(root) = self.root else {
+            return Vec::new();
+        };
+
+        if self.layout.set_params(LayoutParams { root_rect, gap_inner, gap_outer }) {
+            self.layout.mark_dirty(root);
+        }
+
+        let dirty = self.layout.take_dirty();
+        if dirty.is_empty() {
+            return Vec::new();
+        }
+        layout.update(self, &dirty, root_rect.inflate(-gap_outer, -gap_outer), gap_inner)
+    }
+
+    /// Marks the whole tree for recomputation, e.g. after its workspace changed algorithm.
+    /// Node rectangles of the previous algorithm are dropped so they are not taken as split
+    /// rectangles.
+    pub fn invalidate_layout(&mut self) {
+        self.layout.forget_nodes();
+        if let Some(root) = self.root {
+            self.layout.mark_dirty(root);
+        }
+    }
+
+    /// Recomputes the `dirty` subtrees along the tree's splits within `area`, the root's
+    /// rectangle. Returns the windows whose rectangle changed.
+    pub fn update_subtrees(&mut self, dirty: &HashSet<NodeId>, area: Rect, gap_inner: i32) -> Vec<(WindowId, Rect)> {
+        let mut moved = Vec::new();
+        let Some(root) = self.root else {
+            return moved;
+        };
+        for &node in dirty {
+            // Freed nodes are dropped from the dirty set by `LayoutCache::forget_node`.
+            debug_assert_eq!(node.ancestors(&self.arena).last(), Some(root), "dirty node {:?} is detached", node);
+            // Nodes below another dirty node are recomputed as part of that subtree.
+            if node.ancestors(&self.arena).skip(1).any(|id| dirty.contains(&id)) {
+                continue;
+            }
+            match self.cached_node_rect(node, area, gap_inner) {
+                Some(rect) => self.update_node_layout(node, rect, gap_inner, &mut moved),
+                None => {
+                    // The parent was never laid out; fall back to a full pass.
+                    self.update_node_layout(root, area, gap_inner, &mut moved);
+                    break;
+                }
+            }
+        }
+        moved
+    }
+
+    /// Returns the visible window of every tile, in tree order.
+    pub fn visible_windows(&self) -> Vec<WindowId> {
+        let Some(root) = self.root else {
+            return Vec::new();
+        };
+        root.descendants(&self.arena).filter_map(|id| self.visible_window(id)).collect()
+    }
+
+    /// Records rectangles computed without following the tree's splits.
+    /// Returns the windows whose rectangle changed.
+    pub fn store_layout(&mut self, rects: impl IntoIterator<Item = (WindowId, Rect)>) -> Vec<(WindowId, Rect)> {
+        rects.into_iter().filter(|&(win, rect)| self.layout.store_window(win, rect)).collect()
+    }
+
+    /// Returns every visible window with its rectangle from the last `update_layout` pass,
+    /// in tree order, without recomputing anything.
+    pub fn cached_layout(&self) -> Vec<(WindowId, Rect)> {
+        let Some(root) = self.root else {
+            return Vec::new();
+        };
+        root.descendants(&self.arena)
+            .filter_map(|id| match self.arena[id].get() {
+                NodeData::Leaf { visible_window: Some(win), .. } => {
+                    self.layout.window_rect(*win).map(|rect| (*win, rect))
+                }
+                _ => None,
+            })
+            .collect()
+    }
+
+    /// Derives a node's rectangle from its parent's cached rectangle.
+    fn cached_node_rect(&self, node: NodeId, area: Rect, gap_inner: i32) -> Option<Rect> {
+        let Some(parent) = self.arena[node].parent() else {
+            return Some(area);
+        };
+        let parent_rect = self.layout.node_rect(parent)?;
+        self.child_rect(parent, parent_rect, node, gap_inner)
+    }
+
+    /// Returns the rectangle the tree's splits give a node, using the cached rectangles where
+    /// they exist and the parameters of the previous pass otherwise. Used to choose the axis
+    /// of a new split; `None` before the tree's first layout pass.
+    fn split_rect_of(&self, node: NodeId) -> Option<Rect> {
+        if let Some(rect) = self.layout.node_rect(node) {
+            return Some(rect);
+        }
+        let params = self.layout.params()?;
+        let Some(parent) = self.arena[node].parent() else {
+            return Some(params.root_rect.inflate(-params.gap_outer, -params.gap_outer));
+        };
+        let parent_rect = self.split_rect_of(parent)?;
+        self.child_rect(parent, parent_rect, node, params.gap_inner)
+    }
+
+    /// Returns the part of a split's rectangle that goes to one of its children.
+    fn child_rect(&self, parent: NodeId, parent_rect: Rect, child: NodeId, gap_inner: i32) -> Option<Rect> {
+        let NodeData::Split { axis, ratio } = self.arena[parent].get() else {
+            return None;
+        };
+        let (first_rect, second_rect) = split_rect(parent_rect, *axis, *ratio, gap_inner);
+        if self.arena[parent].first_child() == Some(child) {
+            Some(first_rect)
+        } else {
+            Some(second_rect)
+        }
+    }
+
+    /// Recomputes a subtree into the layout cache, collecting windows whose rectangle changed.
+    fn update_node_layout(
+        &mut self,
+        node_id: NodeId,
+        rect: Rect,
+        gap_inner: i32,
+        moved: &mut Vec<(WindowId, Rect)>,
+    ) {
+        self.layout.store_node(node_id, rect);
+        let node = &self.arena[node_id];
+        match node.get() {
+            NodeData::Leaf { visible_window: Some(win), .. } => {
+                if self.layout.store_window(*win, rect) {
+                    moved.push((*win, rect));
+                }
+            }
+            NodeData::Split { axis, ratio } => {
+                if let (Some(first), Some(second)) = (node.first_child(), node.last_child()) {
+                    let (first_rect, second_rect) = split_rect(rect, *axis, *ratio, gap_inner);
+                    self.update_node_layout(first, first_rect, gap_inner, moved);
+                    self.update_node_layout(second, second_rect, gap_inner, moved);
                 }
             }
             _ => {}
         }
     }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::core::geometry::{Point, Size};
+    use crate::core::layout::Bsp;
+
+    /// The area laid out in every test.
+    fn screen() -> Rect {
+        Rect::new(Point::new(0, 0), Size::new(1920, 1080))
+    }
+
+    /// Inserts `windows` in order, each next to the one inserted before it.
+    fn insert_all(tree: &mut BspTree, windows: impl IntoIterator<Item = u32>, max_tiles: usize) {
+        let mut previous = None;
+        for window in windows {
+            let focused = previous.and_then(|previous| tree.find_window(WindowId(previous)));
+            tree.insert_window(WindowId(window), focused, max_tiles, &Bsp);
+            previous = Some(window);
+        }
+    }
+
+    /// Checks that every managed window resolves to an attached leaf holding it.
+    fn check_index(tree: &BspTree) {
+        let root = tree.root.expect("tree is empty");
+        for window in tree.windows() {
+            let leaf = tree.find_window(window).unwrap();
+            assert_eq!(leaf.ancestors(&tree.arena).last(), Some(root), "{:?} is detached", window);
+            match tree.arena[leaf].get() {
+                NodeData::Leaf { visible_window, stack } => {
+                    assert!(*visible_window == Some(window) || stack.contains(&window), "{:?} is not in its leaf", window);
+                }
+                NodeData::Split { .. } => panic!("{:?} resolves to a split", window),
+            }
+        }
+    }
 
-    /// Splits a rectangle into two based on axis, ratio, and inner gap.
-    fn split_rect(&self, rect: Rect, axis: SplitAxis, ratio: f32, gap: i32) -> (Rect, Rect) {
-        match axis {
-            SplitAxis::Horizontal => {
-                let left_width = (rect.width() as f32 * ratio) as i32 - (gap / 2);
-                let right_width = rect.width() - left_width - gap;
-                
-                let left = Rect::new(rect.origin, euclid::default::Size2D::new(left_width, rect.height()));
-                let right = Rect::new(
-                    euclid::default::Point2D::new(rect.min_x() + left_width + gap, rect.min_y()),
-                    euclid::default::Size2D::new(right_width, rect.height())
-                );
-                (left, right)
-            }
-            SplitAxis::Vertical => {
-                let top_height = (rect.height() as f32 * ratio) as i32 - (gap / 2);
-                let bottom_height = rect.height() - top_height - gap;
-                
-                let top = Rect::new(rect.origin, euclid::default::Size2D::new(rect.width(), top_height));
-                let bottom = Rect::new(
-                    euclid::default::Point2D::new(rect.min_x(), rect.min_y() + top_height + gap),
-                    euclid::default::Size2D::new(rect.width(), bottom_height)
-                );
-                (top, bottom)
+    #[test]
+    fn compaction_keeps_the_tree() {
+        let mut tree = BspTree::new();
+        insert_all(&mut tree, 1..=100, 100);
+        // The tile limit is reached, so these are stacked.
+        insert_all(&mut tree, 101..=110, 100);
+        let mut removed = (1..=100).step_by(2).chain((2..=100).step_by(2));
+        while !tree.needs_compaction() {
+            assert!(tree.remove_window(WindowId(removed.next().expect("removals never freed enough nodes"))));
+        }
+        assert!(tree.stats().windows > 10);
+        tree.update_layout(&Bsp, screen(), 5, 10);
+
+        let layout = tree.calculate_layout(screen(), 5, 10);
+        let stats = tree.stats();
+        tree.compact();
+
+        assert!(!tree.needs_compaction());
+        assert_eq!(tree.calculate_layout(screen(), 5, 10), layout);
+        assert_eq!(tree.stats(), TreeStats { arena_nodes: stats.live_nodes, ..stats });
+        check_index(&tree);
+        // The layout cache was remapped, so nothing looks moved.
+        assert!(tree.update_layout(&Bsp, screen(), 5, 10).is_empty());
+
+        // Incremental passes keep working on the new node ids.
+        let focused = tree.windows().min_by_key(|window| window.0).and_then(|window| tree.find_window(window));
+        tree.insert_window(WindowId(1000), focused, 100, &Bsp);
+        assert!(!tree.update_layout(&Bsp, screen(), 5, 10).is_empty());
+        assert_eq!(tree.cached_layout(), tree.calculate_layout(screen(), 5, 10));
+        check_index(&tree);
+    }
+
+    #[test]
+    fn restore_drops_unmapped_windows() {
+        // Windows 1..=24 in tiles of a 16-tile tree, with uneven splits and stacks.
+        let build = || {
+            let mut tree = BspTree::new();
+            insert_all(&mut tree, 1..=24, 16);
+            for window in (2..=16).step_by(3) {
+                tree.set_ratio(WindowId(window), Ratio::from_f32(0.3).unwrap());
             }
+            tree
+        };
+        let dropped = |window: WindowId| window.0 % 3 == 0;
+        let nodes = build().saved_nodes();
+
+        // The saved windows come back under new ids, except the dropped ones.
+        let restored = BspTree::restore(&nodes, |window| (!dropped(window)).then_some(WindowId(window.0 + 500)));
+        // The same tree, with the dropped windows removed one by one.
+        let mut expected = build();
+        for window in (1..=24).map(WindowId).filter(|&window| dropped(window)) {
+            assert!(expected.remove_window(window));
+        }
+
+        let (stats, expected_stats) = (restored.stats(), expected.stats());
+        assert_eq!(stats, TreeStats { arena_nodes: expected_stats.live_nodes, ..expected_stats });
+        check_index(&restored);
+        let renamed: Vec<(WindowId, Rect)> = expected
+            .calculate_layout(screen(), 5, 10)
+            .into_iter()
+            .map(|(window, rect)| (WindowId(window.0 + 500), rect))
+            .collect();
+        assert_eq!(restored.calculate_layout(screen(), 5, 10), renamed);
+        for window in expected.windows() {
+            assert_eq!(restored.stack_size(WindowId(window.0 + 500)), expected.stack_size(window));
         }
     }
+
+    #[test]
+    fn restore_keeps_counters_in_step() {
+        let mut tree = BspTree::new();
+        insert_all(&mut tree, 1..=12, 6);
+        let nodes = tree.saved_nodes();
+
+        // Every window maps to one of two, as a corrupt file could: each is kept once.
+        let restored = BspTree::restore(&nodes, |window| Some(WindowId(window.0 % 2)));
+        assert_eq!(restored.stats().windows, 2);
+        assert_eq!(restored.stats().leaves + restored.stats().stacked, 2);
+        check_index(&restored);
+
+        // Nothing mapped leaves an empty tree.
+        let empty = BspTree::restore(&nodes, |_| None);
+        assert!(empty.root.is_none());
+        assert_eq!(empty.stats(), TreeStats::default());
+    }
 }
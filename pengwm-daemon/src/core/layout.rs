@@ -0,0 +1,301 @@
+//! Layout algorithms that turn a workspace's tree into window rectangles.
+//!
+//! Every workspace keeps its windows in a `BspTree` whichever algorithm arranges them, so
+//! switching algorithms keeps the window order and the stacks. All algorithms go through the
+//! tree's incremental `LayoutCache`: a pass only runs after a mutation marked the tree dirty,
+//! and only windows whose rectangle changed are reported.
+//!
+//! Rectangles are computed in integer arithmetic only, with split ratios in fixed point, so
+//! the same tree always produces the same rectangles and the parts of a split always add up
+//! to the whole. Recomputing an unchanged subtree therefore never reports a window as moved.
+
+use crate::core::bsp::{BspTree, SplitAxis};
+use crate::core::geometry::{Point, Rect, Size};
+use crate::core::types::WindowId;
+use indextree::NodeId;
+use serde::{Serialize, Deserialize};
+use std::collections::HashSet;
+
+/// Share of the workspace given to the master window of `MasterStack`.
+const MASTER_RATIO: Ratio = Ratio::HALF;
+
+/// Number of fixed-point steps in a whole: ratios are multiples of 1/65536.
+const RATIO_SCALE: i64 = 1 << 16;
+
+/// A split ratio in fixed point: the share of a split's length given to its first child.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, Serialize, Deserialize)]
+pub struct Ratio(u16);
+
+impl Ratio {
+    /// An even split.
+    pub const HALF: Ratio = Ratio(1 << 15);
+    /// The smallest share a split may give either child, about 5 percent.
+    pub const MIN: Ratio = Ratio(3277);
+    /// The largest share a split may give its first child, about 95 percent.
+    pub const MAX: Ratio = Ratio((RATIO_SCALE - 3277) as u16);
+
+    /// Converts a fraction, clamped between `MIN` and `MAX`; `None` if it is not finite.
+    pub fn from_f32(fraction: f32) -> Option<Self> {
+        if !fraction.is_finite() {
+            return None;
+        }
+        let steps = (fraction as f64 * RATIO_SCALE as f64).round() as i64;
+        Some(Ratio(steps.clamp(Self::MIN.0 as i64, Self::MAX.0 as i64) as u16))
+    }
+
+    /// Returns this share of `length`, rounded down.
+    fn of(self, length: i32) -> i32 {
+        (length as i64 * self.0 as i64 / RATIO_SCALE) as i32
+    }
+}
+
+/// The layout algorithm of a workspace, as named in `config.toml`.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+#[serde(rename_all = "kebab-case")]
+pub enum LayoutKind {
+    /// Every new window splits the focused tile in two along its longer side.
+    #[default]
+    Bsp,
+    /// The first window takes one half of the workspace; the others share the other half.
+    MasterStack,
+    /// Every window fills the workspace; the focused one is raised above the others.
+    Monocle,
+}
+
+impl LayoutKind {
+    /// Returns the algorithm implementing this kind.
+    pub fn layout(self) -> &'static dyn Layout {
+        match self {
+            LayoutKind::Bsp => &Bsp,
+            LayoutKind::MasterStack => &MasterStack,
+            LayoutKind::Monocle => &Monocle,
+        }
+    }
+}
+
+/// A way of arranging the visible windows of a tree.
+pub trait Layout: Sync {
+    /// Chooses how to split a tile occupying `rect` when a window is inserted next to it.
+    ///
+    /// Splitting along the longer side keeps both halves usable on ultrawide and portrait
+    /// displays. Algorithms that ignore the splits keep this too, so the tree is well shaped
+    /// if the workspace switches back to `Bsp`.
+    fn split_axis(&self, rect: Option<Rect>) -> SplitAxis {
+        match rect {
+            Some(rect) if rect.height() > rect.width() => SplitAxis::Vertical,
+            _ => SplitAxis::Horizontal,
+        }
+    }
+
+    /// Recomputes the rectangles of the tree's visible windows within `area`, the workspace
+    /// without its outer gaps, given the subtrees marked dirty since the previous pass.
+    /// Returns the windows whose rectangle changed.
+    fn update(&self, tree: &mut BspTree, dirty: &HashSet<NodeId>, area: Rect, gap: i32) -> Vec<(WindowId, Rect)>;
+}
+
+/// Follows the tree's splits, recomputing only the dirty subtrees.
+pub struct Bsp;
+
+impl Layout for Bsp {
+    fn update(&self, tree: &mut BspTree, dirty: &HashSet<NodeId>, area: Rect, gap: i32) -> Vec<(WindowId, Rect)> {
+        tree.update_subtrees(dirty, area, gap)
+    }
+}
+
+/// A master window beside a column (or, on portrait displays, a row) of the other windows,
+/// in tree order.
+pub struct MasterStack;
+
+impl Layout for MasterStack {
+    fn update(&self, tree: &mut BspTree, _dirty: &HashSet<NodeId>, area: Rect, gap: i32) -> Vec<(WindowId, Rect)> {
+        let windows = tree.visible_windows();
+        let rects = match windows.len() {
+            0 => Vec::new(),
+            1 => vec![area],
+            count => {
+                let axis = self.split_axis(Some(area));
+                let (master, stack) = split_rect(area, axis, MASTER_RATIO, gap);
+                std::iter::once(master).chain(divide(stack, perpendicular(axis), count - 1, gap)).collect()
+            }
+        };
+        tree.store_layout(windows.into_iter().zip(rects))
+    }
+}
+
+/// Every visible window fills the workspace.
+pub struct Monocle;
+
+impl Layout for Monocle {
+    fn update(&self, tree: &mut BspTree, _dirty: &HashSet<NodeId>, area: Rect, _gap: i32) -> Vec<(WindowId, Rect)> {
+        let windows = tree.visible_windows();
+        tree.store_layout(windows.into_iter().map(|window| (window, area)))
+    }
+}
+
+/// Splits a rectangle into two based on axis, ratio, and inner gap.
+/// The ratio applies to the length left after the gap, and the second part gets the rest,
+/// so the two parts and the gap always cover exactly the input rectangle.
+pub fn split_rect(rect: Rect, axis: SplitAxis, ratio: Ratio, gap: i32) -> (Rect, Rect) {
+    match axis {
+        SplitAxis::Horizontal => {
+            let available = (rect.width() - gap).max(0);
+            let left_width = ratio.of(available);
+            let right_width = available - left_width;
+
+            let left = Rect::new(rect.origin, Size::new(left_width, rect.height()));
+            let right = Rect::new(
+                Point::new(rect.min_x() + left_width + gap, rect.min_y()),
+                Size::new(right_width, rect.height()),
+            );
+            (left, right)
+        }
+        SplitAxis::Vertical => {
+            let available = (rect.height() - gap).max(0);
+            let top_height = ratio.of(available);
+            let bottom_height = available - top_height;
+
+            let top = Rect::new(rect.origin, Size::new(rect.width(), top_height));
+            let bottom = Rect::new(
+                Point::new(rect.min_x(), rect.min_y() + top_height + gap),
+                Size::new(rect.width(), bottom_height),
+            );
+            (top, bottom)
+        }
+    }
+}
+
+/// Divides a rectangle into `count` equal parts along `axis`, `gap` apart. Pixels that do
+/// not divide evenly go to the first parts, so the parts always cover the whole rectangle.
+fn divide(rect: Rect, axis: SplitAxis, count: usize, gap: i32) -> Vec<Rect> {
+    let count = count as i32;
+    let length = match axis {
+        SplitAxis::Horizontal => rect.width(),
+        SplitAxis::Vertical => rect.height(),
+    };
+    let available = (length - gap * (count - 1)).max(0);
+    let (base, extra) = (available / count, available % count);
+    let mut offset = 0;
+    (0..count)
+        .map(|index| {
+            let size = base + i32::from(index < extra);
+            let part = match axis {
+                SplitAxis::Horizontal => Rect::new(
+                    Point::new(rect.min_x() + offset, rect.min_y()),
+                    Size::new(size, rect.height()),
+                ),
+                SplitAxis::Vertical => Rect::new(
+                    Point::new(rect.min_x(), rect.min_y() + offset),
+                    Size::new(rect.width(), size),
+                ),
+            };
+            offset += size + gap;
+            part
+        })
+        .collect()
+}
+
+/// Returns the other axis.
+fn perpendicular(axis: SplitAxis) -> SplitAxis {
+    match axis {
+        SplitAxis::Horizontal => SplitAxis::Vertical,
+        SplitAxis::Vertical => SplitAxis::Horizontal,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use proptest::collection::vec;
+    use proptest::prelude::*;
+
+    /// Either split axis.
+    fn axis() -> impl Strategy<Value = SplitAxis> {
+        prop_oneof![Just(SplitAxis::Horizontal), Just(SplitAxis::Vertical)]
+    }
+
+    /// Any valid split ratio.
+    fn ratio() -> impl Strategy<Value = Ratio> {
+        (Ratio::MIN.0..=Ratio::MAX.0).prop_map(Ratio)
+    }
+
+    /// A rectangle anywhere on a large desktop, possibly empty.
+    fn rect() -> impl Strategy<Value = Rect> {
+        (-8000..8000, -8000..8000, 0..8000, 0..8000)
+            .prop_map(|(x, y, width, height)| Rect::new(Point::new(x, y), Size::new(width, height)))
+    }
+
+    /// Returns where `rect` starts and ends along `axis`.
+    fn span(rect: Rect, axis: SplitAxis) -> (i32, i32) {
+        match axis {
+            SplitAxis::Horizontal => (rect.min_x(), rect.max_x()),
+            SplitAxis::Vertical => (rect.min_y(), rect.max_y()),
+        }
+    }
+
+    /// Checks that `parts` follow each other along `axis`, `gap` apart and never overlapping,
+    /// from the start of `rect` to its end, each spanning all of `rect` the other way.
+    fn check_partition(rect: Rect, axis: SplitAxis, parts: &[Rect], gap: i32) -> Result<(), TestCaseError> {
+        let across = perpendicular(axis);
+        let mut next = span(rect, axis).0;
+        for part in parts {
+            let (start, end) = span(*part, axis);
+            prop_assert_eq!(start, next);
+            prop_assert!(end >= start);
+            prop_assert_eq!(span(*part, across), span(rect, across));
+            next = end + gap;
+        }
+        prop_assert_eq!(next - gap, span(rect, axis).1);
+        Ok(())
+    }
+
+    proptest! {
+        #[test]
+        fn split_partitions_exactly(rect in rect(), axis in axis(), ratio in ratio(), gap in 0..64) {
+            prop_assume!(span(rect, axis).1 - span(rect, axis).0 >= gap);
+            let (first, second) = split_rect(rect, axis, ratio, gap);
+            check_partition(rect, axis, &[first, second], gap)?;
+        }
+
+        #[test]
+        fn divide_partitions_exactly(rect in rect(), axis in axis(), count in 1..64usize, gap in 0..32) {
+            let (start, end) = span(rect, axis);
+            prop_assume!(end - start >= gap * (count as i32 - 1));
+            let parts = divide(rect, axis, count, gap);
+            prop_assert_eq!(parts.len(), count);
+            check_partition(rect, axis, &parts, gap)?;
+            // Leftover pixels are spread one per part.
+            let lengths: Vec<i32> = parts.iter().map(|part| span(*part, axis).1 - span(*part, axis).0).collect();
+            prop_assert!(lengths.iter().max().unwrap() - lengths.iter().min().unwrap() <= 1);
+        }
+
+        #[test]
+        fn tiles_cover_the_workspace(
+            anchors in vec(any::<u32>(), 1..48),
+            ratios in vec(ratio(), 48),
+            width in 800..4000,
+            height in 600..3000,
+        ) {
+            // Each window splits the tile of an earlier one, then its split gets a random ratio.
+            let mut tree = BspTree::new();
+            for (index, anchor) in anchors.iter().enumerate() {
+                let focused = (index > 0).then(|| tree.find_window(WindowId(1 + anchor % index as u32))).flatten();
+                tree.insert_window(WindowId(1 + index as u32), focused, anchors.len(), &Bsp);
+            }
+            for (index, &ratio) in ratios.iter().take(anchors.len()).enumerate() {
+                tree.set_ratio(WindowId(1 + index as u32), ratio);
+            }
+
+            let area = Rect::new(Point::new(-width / 2, 40), Size::new(width, height));
+            let tiles = tree.calculate_layout(area, 0, 0);
+            prop_assert_eq!(tiles.len(), anchors.len());
+            let covered: i64 = tiles.iter().map(|(_, tile)| tile.area() as i64).sum();
+            prop_assert_eq!(covered, area.area() as i64);
+            for (index, (_, tile)) in tiles.iter().enumerate() {
+                prop_assert!(area.contains_rect(tile));
+                for (_, other) in &tiles[index + 1..] {
+                    prop_assert!(!tile.intersects(other));
+                }
+            }
+        }
+    }
+}
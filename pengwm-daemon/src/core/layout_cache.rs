@@ -0,0 +1,120 @@
+//! Incremental layout cache for the BSP tree.
+//!
+//! Stores the last computed rectangle of every node and visible window, so a layout
+//! pass only revisits the subtrees that tree mutations marked dirty since the previous pass.
+//! Layouts that do not follow the tree's splits only use the window rectangles.
+
+use crate::core::geometry::Rect;
+use crate::core::types::WindowId;
+use indextree::NodeId;
+use std::collections::{HashMap, HashSet};
+use std::sync::Arc;
+
+/// The inputs a cached layout was computed from. Changing any of them invalidates the whole cache.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct LayoutParams {
+    /// The display area available for tiling.
+    pub root_rect: Rect,
+    /// Margin between adjacent windows.
+    pub gap_inner: i32,
+    /// Margin between windows and the display edge.
+    pub gap_outer: i32,
+}
+
+/// The complete result of one layout pass, cheap to clone and share.
+#[derive(Debug, Clone, Default)]
+pub struct LayoutSnapshot {
+    /// Incremented by every layout pass; consumers compare it to skip unchanged snapshots.
+    pub version: u64,
+    /// Every visible window with the rectangle assigned to it, in tree order.
+    pub windows: Arc<Vec<(WindowId, Rect)>>,
+}
+
+/// Per-node and per-window rectangles from the last layout pass, plus the set of stale subtrees.
+#[derive(Debug, Default)]
+pub struct LayoutCache {
+    /// Parameters of the last pass, or `None` if nothing has been computed yet.
+    params: Option<LayoutParams>,
+    /// The rectangle assigned to each node in the last pass.
+    node_rects: HashMap<NodeId, Rect>,
+    /// The rectangle assigned to each visible window in the last pass.
+    window_rects: HashMap<WindowId, Rect>,
+    /// Roots of subtrees whose rectangles must be recomputed.
+    dirty: HashSet<NodeId>,
+}
+
+impl LayoutCache {
+    /// Creates an empty cache.
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Marks the subtree rooted at `node` as needing recomputation.
+    pub fn mark_dirty(&mut self, node: NodeId) {
+        self.dirty.insert(node);
+    }
+
+    /// Takes the set of dirty subtree roots, leaving the cache clean.
+    pub fn take_dirty(&mut self) -> HashSet<NodeId> {
+        std::mem::take(&mut self.dirty)
+    }
+
+    /// Records the parameters for the upcoming pass.
+    /// Returns `true` if they differ from the previous pass and everything must be recomputed.
+    pub fn set_params(&mut self, params: LayoutParams) -> bool {
+        self.params.replace(params) != Some(params)
+    }
+
+    /// Returns the parameters of the last pass, if there was one.
+    pub fn params(&self) -> Option<LayoutParams> {
+        self.params
+    }
+
+    /// Returns the rectangle computed for `node` in the last pass.
+    pub fn node_rect(&self, node: NodeId) -> Option<Rect> {
+        self.node_rects.get(&node).copied()
+    }
+
+    /// Returns the rectangle computed for `window` in the last pass.
+    pub fn window_rect(&self, window: WindowId) -> Option<Rect> {
+        self.window_rects.get(&window).copied()
+    }
+
+    /// Stores the rectangle computed for `node`.
+    pub fn store_node(&mut self, node: NodeId, rect: Rect) {
+        self.node_rects.insert(node, rect);
+    }
+
+    /// Stores the rectangle computed for `window`.
+    /// Returns `true` if it differs from the previous one, i.e. the window moved.
+    pub fn store_window(&mut self, window: WindowId, rect: Rect) -> bool {
+        self.window_rects.insert(window, rect) != Some(rect)
+    }
+
+    /// Drops everything cached for a node that was removed from the tree.
+    pub fn forget_node(&mut self, node: NodeId) {
+        self.node_rects.remove(&node);
+        self.dirty.remove(&node);
+    }
+
+    /// Drops every cached node rectangle, keeping the window rectangles to compare against.
+    pub fn forget_nodes(&mut self) {
+        self.node_rects.clear();
+    }
+
+    /// Rewrites every cached node ID after the arena was rebuilt. Nodes missing from `remap`
+    /// no longer exist and are dropped.
+    pub fn remap_nodes(&mut self, remap: &HashMap<NodeId, NodeId>) {
+        self.node_rects = self
+            .node_rects
+            .drain()
+            .filter_map(|(node, rect)| remap.get(&node).map(|&new| (new, rect)))
+            .collect();
+        self.dirty = self.dirty.drain().filter_map(|node| remap.get(&node).copied()).collect();
+    }
+
+    /// Drops the cached rectangle of a window that was removed or hidden in a stack.
+    pub fn forget_window(&mut self, window: WindowId) {
+        self.window_rects.remove(&window);
+    }
+}
@@ -1,25 +1,96 @@
 //! Core window management logic.
 //! Orchestrates the BSP tree, backend interactions, and UI synchronization.
 
-use crate::core::bsp::BspTree;
-use crate::core::types::SystemEvent;
+use crate::core::bsp::{BspTree, CycleDirection};
+use crate::core::monitor::{Location, MonitorRegistry};
+use crate::core::types::{MonitorId, SystemEvent, WindowId};
 use crate::core::geometry::Rect;
-use crate::platform::WindowManagerBackend;
+use crate::core::layout::{LayoutKind, Ratio};
+use crate::core::layout_cache::LayoutSnapshot;
+use crate::core::metrics::metrics;
+use crate::core::session::{self, SavedDisplay, SavedWorkspace, Session, WindowKey};
+use crate::platform::{WindowManagerBackend, FrameChange};
 use crate::config::Config;
-use crate::ipc::{IpcServer, UiState, WindowInfo};
-use tokio::sync::mpsc::Receiver;
+use crate::config::rules::{RuleAction, RuleSet};
+use crate::ipc::{IpcCommand, IpcReply, IpcServer, PendingCommand, UiState, WindowInfo};
+use crate::core::queue::{EventReceiver, QueueStats};
+use std::collections::{HashMap, HashSet};
+use std::path::PathBuf;
 use std::sync::Arc;
+use std::time::{Duration, Instant};
+use tokio::sync::{mpsc, oneshot};
+use tracing::Instrument;
+
+/// How often tree arenas are checked for compaction.
+const COMPACTION_INTERVAL: Duration = Duration::from_secs(300);
+
+/// How often the trees are written to the session file, if they changed.
+const SESSION_INTERVAL: Duration = Duration::from_secs(2);
+
+/// How long a window must stay still after a move before it is put back in its tile, so a
+/// drag is not fought while it lasts.
+const MOVE_SETTLE: Duration = Duration::from_millis(300);
+
+/// Follow-up work accumulated while handling a batch of events.
+#[derive(Debug, Default)]
+struct PendingPass {
+    /// Workspaces whose tree changed and whose window rectangles must be recomputed and applied.
+    relayout: HashSet<Location>,
+    /// Workspace switches in the order they happened, as (display, workspace shown before).
+    switched: Vec<(MonitorId, usize)>,
+    /// When the first switch of the batch was requested, for measuring switch latency.
+    switch_started: Option<Instant>,
+    /// Windows that became visible in their tile and must be brought to the front.
+    raise: Vec<WindowId>,
+    /// Windows moved by something else, to be sent their layout rectangle again.
+    restore: HashSet<WindowId>,
+    /// The OS reported a display configuration change; the display list must be re-queried.
+    monitors_changed: bool,
+    /// The focused window changed, which the UI can be told about without a full state.
+    focus_changed: bool,
+    /// A window title changed, so the UI needs a state update even without a layout pass.
+    titles_changed: bool,
+    /// The backend's startup discovery arrived in this batch.
+    discovered: bool,
+    /// `GetState` requests, answered once the batch's layout has been applied.
+    state_requests: Vec<oneshot::Sender<IpcReply>>,
+}
 
 /// The central coordinator for window management.
 pub struct WindowManager {
-    /// The Binary Space Partitioning tree that stores window positions.
-    tree: BspTree,
+    /// Connected displays, each with the BSP tree that stores its window positions.
+    monitors: MonitorRegistry,
     /// The platform-specific backend (macOS or Windows).
     backend: Arc<dyn WindowManagerBackend + Send + Sync>,
     /// Current configuration settings.
     config: Config,
     /// IPC server for broadcasting state updates to the UI.
     ipc_server: Arc<IpcServer>,
+    /// Windows a `float` rule keeps out of the layout; we hold their reference until destroyed.
+    floating: HashSet<WindowId>,
+    /// The most recently focused window, used as the insertion point for new windows.
+    focused: Option<WindowId>,
+    /// The rectangle last successfully applied to each window through the backend.
+    applied: HashMap<WindowId, Rect>,
+    /// Managed windows reported as moved, with when the latest report arrived; checked once
+    /// they have settled.
+    moved: HashMap<WindowId, Instant>,
+    /// The frame each window was last put back from. A window found there again is kept
+    /// there by its application, e.g. because of a minimum size, and is left alone.
+    restored: HashMap<WindowId, Rect>,
+    /// The result of the most recent layout pass, reused when synchronizing the UI.
+    snapshot: LayoutSnapshot,
+    /// Version of the snapshot most recently broadcast to the UI.
+    broadcast_version: u64,
+    /// When the manager was created, right after the backend started; cleared once the
+    /// windows found at startup have been laid out.
+    startup: Option<Instant>,
+    /// Where the trees are saved for the next start; not saved if unset.
+    session_path: Option<PathBuf>,
+    /// The session saved by the previous run, restored when startup discovery arrives.
+    session: Option<Session>,
+    /// The trees or window titles changed since the session was last saved.
+    session_dirty: bool,
 }
 
 impl WindowManager {
@@ -30,119 +101,785 @@ impl WindowManager {
         ipc_server: Arc<IpcServer>,
     ) -> Self {
         Self {
-            tree: BspTree::new(),
+            monitors: MonitorRegistry::new(config.max_tiles, config.layouts()),
             backend,
             config,
             ipc_server,
+            floating: HashSet::new(),
+            focused: None,
+            applied: HashMap::new(),
+            moved: HashMap::new(),
+            restored: HashMap::new(),
+            snapshot: LayoutSnapshot::default(),
+            broadcast_version: 0,
+            startup: Some(Instant::now()),
+            session_path: None,
+            session: None,
+            session_dirty: false,
         }
     }
 
+    /// Restores the session saved at `path`, if any, when the windows found at startup arrive,
+    /// and saves the trees there from now on.
+    pub fn with_session(mut self, path: PathBuf) -> Self {
+        self.session = Session::load(&path);
+        if let Some(session) = &self.session {
+            log::info!("Found a saved session with {} window(s)", session.windows.len());
+        }
+        self.session_path = Some(path);
+        self
+    }
+
     /// The main execution loop of the Window Manager.
-    /// Listens for system events and updates the layout accordingly.
-    pub async fn run(&mut self, mut event_rx: Receiver<SystemEvent>) {
+    /// Listens for system events and client commands and updates the layout accordingly.
+    pub async fn run(&mut self, mut event_rx: EventReceiver, mut command_rx: mpsc::Receiver<PendingCommand>) {
         log::info!("WindowManager loop started.");
 
-        // Initial monitor geometry. 
-        // TODO: In a multi-monitor setup, this should be queried per event.
-        let monitor_rect = Rect::new(
-            euclid::default::Point2D::new(0, 0),
-            euclid::default::Size2D::new(1920, 1080)
-        );
+        // Display geometry is cached and only re-queried when the OS reports a change.
+        self.monitors.update(self.backend.monitors());
+
+        // Continuous loop to process window events and client commands.
+        let mut compaction = tokio::time::interval(COMPACTION_INTERVAL);
+        compaction.set_missed_tick_behavior(tokio::time::MissedTickBehavior::Delay);
+        let mut session_save = tokio::time::interval(SESSION_INTERVAL);
+        session_save.set_missed_tick_behavior(tokio::time::MissedTickBehavior::Delay);
+        loop {
+            let mut pass = PendingPass::default();
+            let settled_at = self.moved.values().min().map(|&moved| tokio::time::Instant::from_std(moved + MOVE_SETTLE));
+            tokio::select! {
+                event = event_rx.recv() => {
+                    let Some(event) = event else {
+                        break;
+                    };
+                    metrics().queue_depth.record(event_rx.stats().queued);
+                    // Give a burst (e.g. startup discovery) a moment to arrive, then drain it as one batch.
+                    let debounce = Duration::from_millis(self.config.debounce_ms);
+                    if !debounce.is_zero() {
+                        tokio::time::sleep(debounce).await;
+                    }
+                    self.handle_event(event, &mut pass);
+                }
+                Some(command) = command_rx.recv() => self.handle_command(command, &mut pass),
+                _ = compaction.tick() => {
+                    // Node IDs never leave the trees, so compaction needs no layout pass.
+                    let compacted = self.monitors.compact();
+                    if compacted > 0 {
+                        log::debug!("Compacted {} tree arena(s)", compacted);
+                    }
+                    continue;
+                }
+                _ = session_save.tick() => {
+                    self.save_session().await;
+                    continue;
+                }
+                _ = tokio::time::sleep_until(settled_at.unwrap_or_else(tokio::time::Instant::now)), if settled_at.is_some() => {
+                    self.check_moved(&mut pass).await;
+                }
+            }
+
+            {
+                let _span = tracing::debug_span!("receive").entered();
+                let mut batch_size = 1;
+                while let Some(event) = event_rx.try_recv() {
+                    self.handle_event(event, &mut pass);
+                    batch_size += 1;
+                }
+                // Pipelined commands that are already queued share the same pass.
+                while let Ok(command) = command_rx.try_recv() {
+                    self.handle_command(command, &mut pass);
+                    batch_size += 1;
+                }
+                log::debug!("Processed a batch of {} event(s)", batch_size);
+            }
+
+            // A burst of display notifications costs a single query.
+            if pass.monitors_changed {
+                let changed = self.monitors.update(self.backend.monitors());
+                pass.relayout.extend(changed);
+            }
+
+            // One layout pass over the changed workspaces and at most one UI broadcast per batch.
+            let queued = event_rx.take_oldest();
+            if !pass.relayout.is_empty() || !pass.switched.is_empty() || !pass.restore.is_empty() {
+                let span = tracing::debug_span!("layout", workspaces = pass.relayout.len());
+                let frames = self.apply_layout(&pass).instrument(span).await;
+                if let (Some(queued), true) = (queued, frames > 0) {
+                    metrics().event_to_frame.record_duration(queued.elapsed());
+                }
+                if let Some(started) = pass.switch_started {
+                    log::info!("Switched workspaces in {:?} ({} frame(s))", started.elapsed(), frames);
+                }
+            }
+            if pass.discovered {
+                if let Some(started) = self.startup.take() {
+                    log::info!(
+                        "Time to first layout: {:?} ({} window(s) managed)",
+                        started.elapsed(),
+                        self.monitors.stats().windows
+                    );
+                }
+            }
+            if !pass.raise.is_empty() {
+                self.raise_windows(std::mem::take(&mut pass.raise)).await;
+            }
+            if self.snapshot.version != self.broadcast_version || pass.titles_changed {
+                self.sync_ui(event_rx.stats());
+            } else if pass.focus_changed {
+                self.ipc_server.broadcast_focus(self.focused.map(|id| id.0));
+            }
+            if !pass.relayout.is_empty() || !pass.switched.is_empty() || pass.titles_changed {
+                self.session_dirty = true;
+            }
+            for reply in pass.state_requests {
+                let _ = reply.send(IpcReply::State(self.ipc_server.current_state()));
+            }
+        }
+    }
+
+    /// Executes a client command and replies to it, except for `GetState`, which is
+    /// answered after the batch so it reflects every command that came before it.
+    fn handle_command(&mut self, pending: PendingCommand, pass: &mut PendingPass) {
+        let PendingCommand { command, reply } = pending;
+        let _span = tracing::debug_span!("command", ?command).entered();
+        log::debug!("Handling IPC command: {:?}", command);
+        if let IpcCommand::GetState = command {
+            pass.state_requests.push(reply);
+            return;
+        }
+        let result = match self.execute(command, pass) {
+            Ok(()) => IpcReply::Ok,
+            Err(e) => IpcReply::Error(e),
+        };
+        let _ = reply.send(result);
+    }
+
+    /// Applies a command to the tree and configuration, recording the work it needs.
+    /// The commands of a batch are all applied before the single layout pass that follows.
+    fn execute(&mut self, command: IpcCommand, pass: &mut PendingPass) -> Result<(), String> {
+        match command {
+            IpcCommand::SetMaxTiles { workspace, limit } => {
+                if limit == 0 {
+                    return Err("max_tiles must be at least 1".into());
+                }
+                // Folds or unfolds stacks on that workspace of every display.
+                let changed = self
+                    .monitors
+                    .set_max_tiles(workspace as usize, limit)
+                    .ok_or_else(|| format!("workspace {} does not exist", workspace))?;
+                pass.relayout.extend(changed);
+                Ok(())
+            }
+            IpcCommand::ReloadConfig => {
+                let config = Config::try_load()?;
+                self.apply_config(config, pass);
+                Ok(())
+            }
+            IpcCommand::SwapWindows { a, b } => {
+                let (a, b) = (WindowId(a), WindowId(b));
+                let location = match (self.monitors.location_of(a), self.monitors.location_of(b)) {
+                    (Some(la), Some(lb)) if la == lb => la,
+                    (Some(_), Some(_)) => return Err("windows on different workspaces cannot be swapped".into()),
+                    _ => return Err(format!("windows {} and {} are not both managed", a.0, b.0)),
+                };
+                if let Some(tree) = self.monitors.tree_of_mut(a) {
+                    tree.swap_windows(a, b);
+                }
+                pass.relayout.insert(location);
+                Ok(())
+            }
+            IpcCommand::SwitchWorkspace { workspace } => {
+                let monitor = self.focused_monitor().ok_or("no display available")?;
+                self.switch_workspace(monitor, workspace as usize, pass);
+                Ok(())
+            }
+            IpcCommand::MoveToWorkspace { window, workspace } => {
+                let id = WindowId(window);
+                let Some(from) = self.monitors.move_window(id, workspace as usize) else {
+                    return Err(format!("window {} cannot be moved to workspace {}", window, workspace));
+                };
+                pass.relayout.insert(from);
+                pass.relayout.insert(Location { monitor: from.monitor, workspace: workspace as usize });
+                Ok(())
+            }
+            IpcCommand::SetRatio { window, ratio } => {
+                let Some(ratio) = Ratio::from_f32(ratio) else {
+                    return Err(format!("invalid ratio {}", ratio));
+                };
+                let id = WindowId(window);
+                let location = self.monitors.location_of(id);
+                let updated = self.monitors.tree_of_mut(id).is_some_and(|tree| tree.set_ratio(id, ratio));
+                match location {
+                    Some(location) if updated => {
+                        pass.relayout.insert(location);
+                        Ok(())
+                    }
+                    _ => Err(format!("window {} is not in a split", window)),
+                }
+            }
+            IpcCommand::CycleStack { window, reverse } => {
+                let id = self.command_target(window)?;
+                let direction = if reverse { CycleDirection::Backward } else { CycleDirection::Forward };
+                let shown = self.monitors.tree_of_mut(id).and_then(|tree| tree.cycle_stack(id, direction));
+                let shown = shown.ok_or_else(|| format!("window {} has no stacked windows", id.0))?;
+                self.stack_changed(id, shown, pass);
+                Ok(())
+            }
+            IpcCommand::PromoteWindow { window } => {
+                let id = WindowId(window);
+                if !self.monitors.tree_of_mut(id).is_some_and(|tree| tree.promote_window(id)) {
+                    return Err(format!("window {} is not stacked", window));
+                }
+                self.stack_changed(id, id, pass);
+                Ok(())
+            }
+            IpcCommand::SendToBack { window } => {
+                let id = self.command_target(window)?;
+                let tree = self.monitors.tree_of_mut(id).ok_or_else(|| format!("window {} is not managed", id.0))?;
+                let leaf = tree.find_window(id);
+                if !tree.send_to_back(id) {
+                    return Err(format!("window {} has no stacked windows", id.0));
+                }
+                // Whichever window is now visible in that tile comes to the front.
+                let shown = leaf.and_then(|leaf| tree.visible_window(leaf)).unwrap_or(id);
+                self.stack_changed(id, shown, pass);
+                Ok(())
+            }
+            IpcCommand::Batch { commands } => {
+                let errors: Vec<String> = commands
+                    .into_iter()
+                    .filter_map(|command| self.execute(command, pass).err())
+                    .collect();
+                if errors.is_empty() {
+                    Ok(())
+                } else {
+                    Err(errors.join("; "))
+                }
+            }
+            IpcCommand::GetState => Err("GetState cannot be part of a batch".into()),
+            IpcCommand::GetMetrics => Err("GetMetrics cannot be part of a batch".into()),
+        }
+    }
 
-        // Continuous loop to process window events.
-        while let Some(event) = event_rx.recv().await {
-            match event {
-                SystemEvent::WindowCreated(win) => {
-                    log::info!("Handling WindowCreated: {:?}", win);
-                    // Avoid managing the same window multiple times.
-                    if self.tree.contains_window(win) {
+    /// Applies a single event to the tree, recording what work the batch needs afterwards.
+    fn handle_event(&mut self, event: SystemEvent, pass: &mut PendingPass) {
+        let _span = tracing::trace_span!("mutate", ?event).entered();
+        match event {
+            SystemEvent::WindowCreated(win) => {
+                log::trace!("Handling WindowCreated: {:?}", win);
+                // Avoid managing the same window multiple times. Backends hold one reference
+                // per window id, which the managed entry already owns.
+                if self.monitors.contains_window(win) || self.floating.contains(&win) {
+                    return;
+                }
+                if self.admit_window(win) {
+                    self.place_window(win, pass);
+                }
+            }
+            SystemEvent::WindowsDiscovered(windows) => {
+                log::info!("Handling {} discovered window(s)", windows.len());
+                pass.discovered = true;
+                let mut seen = HashSet::new();
+                let mut tiled = Vec::with_capacity(windows.len());
+                for win in windows {
+                    if self.monitors.contains_window(win) || self.floating.contains(&win) || !seen.insert(win) {
                         continue;
                     }
-                    // Only manage windows that pass the backend's filtering rules.
-                    if self.backend.is_manageable(win) {
-                        // Insert the window into the BSP tree.
-                        self.tree.insert_window(win, None, self.config.max_tiles);
-                        // Re-calculate and apply the layout to all windows.
-                        self.apply_layout(monitor_rect).await;
-                        // Notify the UI of the change.
-                        self.sync_ui();
-                    } else {
-                        // If it's not manageable, release any retained reference.
-                        self.backend.release_window(win);
+                    if self.admit_window(win) {
+                        tiled.push(win);
                     }
                 }
-                SystemEvent::WindowDestroyed(win) => {
-                    log::info!("Handling WindowDestroyed: {:?}", win);
-                    // TODO: Implement window removal logic in the BspTree.
-                    // Release our retained reference to the window element.
+                // Windows of the previous session go back to their tiles; the rest are new.
+                if let Some(session) = self.session.take() {
+                    tiled = self.restore_session(session, tiled, pass);
+                }
+                for win in tiled {
+                    self.place_window(win, pass);
+                }
+            }
+            SystemEvent::WindowDestroyed(win) => {
+                log::trace!("Handling WindowDestroyed: {:?}", win);
+                // Only windows we manage hold a retained reference.
+                if self.floating.remove(&win) {
                     self.backend.release_window(win);
-                    self.sync_ui();
+                    return;
                 }
-                SystemEvent::WindowFocused(win) => {
-                    log::info!("Handling WindowFocused: {:?}", win);
-                    // Focus changes might update UI elements like borders.
-                    self.sync_ui();
+                let Some(location) = self.monitors.remove_window(win) else {
+                    return;
+                };
+                if self.focused == Some(win) {
+                    self.focused = None;
                 }
-                _ => {}
+                self.applied.remove(&win);
+                self.moved.remove(&win);
+                self.restored.remove(&win);
+                // Release our retained reference to the window element.
+                self.backend.release_window(win);
+                pass.relayout.insert(location);
             }
+            SystemEvent::WindowFocused(win) => {
+                log::trace!("Handling WindowFocused: {:?}", win);
+                if let Some(location) = self.monitors.location_of(win) {
+                    self.focused = Some(win);
+                    // Focusing a window on a hidden workspace (e.g. via the app switcher) shows it.
+                    self.switch_workspace(location.monitor, location.workspace, pass);
+                    // Monocle windows all share one rectangle, so the focused one goes on top.
+                    let monocle = self
+                        .monitors
+                        .display(location.monitor)
+                        .is_some_and(|display| display.workspaces[location.workspace].algorithm == LayoutKind::Monocle);
+                    if monocle && !pass.raise.contains(&win) {
+                        pass.raise.push(win);
+                    }
+                }
+                // Focus changes might update UI elements like borders.
+                pass.focus_changed = true;
+            }
+            SystemEvent::WindowMoved(win) => {
+                // Our own frames are reported too; the frame is only read once the window
+                // stops moving.
+                if self.applied.contains_key(&win) {
+                    self.moved.insert(win, Instant::now());
+                }
+            }
+            SystemEvent::WindowTitleChanged(win) => {
+                log::trace!("Handling WindowTitleChanged: {:?}", win);
+                if self.monitors.contains_window(win) {
+                    pass.titles_changed = true;
+                }
+            }
+            SystemEvent::AppLaunched(pid) => {
+                // Its windows arrive as WindowCreated once the backend observes them.
+                log::info!("Application launched (PID {})", pid);
+            }
+            SystemEvent::MonitorAdded(id) | SystemEvent::MonitorRemoved(id) | SystemEvent::MonitorChanged(id) => {
+                log::info!("Display configuration changed ({:?})", id);
+                pass.monitors_changed = true;
+            }
+            _ => {}
         }
     }
 
-    /// Calculates the rectangles for all windows in the tree and applies them via the backend.
-    /// 
-    /// # Arguments
-    /// * `monitor_rect` - The display area available for tiling.
-    async fn apply_layout(&self, monitor_rect: Rect) {
-        let layouts = self.tree.calculate_layout(
-            monitor_rect,
-            self.config.gap_inner,
-            self.config.gap_outer
+    /// Applies the window rules and the backend's filtering to a new window. Returns `true`
+    /// if it should be tiled; floated windows are recorded and ignored ones released.
+    fn admit_window(&mut self, win: WindowId) -> bool {
+        // A matching rule overrides the backend's heuristics; otherwise only manage
+        // windows that pass its filtering.
+        match self.backend.window_rule(win) {
+            Some(RuleAction::Tile) => true,
+            Some(RuleAction::Float) => {
+                log::debug!("Floating {:?} by rule", win);
+                self.floating.insert(win);
+                false
+            }
+            Some(RuleAction::Ignore) => {
+                log::debug!("Ignoring {:?} by rule", win);
+                self.backend.release_window(win);
+                false
+            }
+            None if !self.backend.is_manageable(win) => {
+                // If it's not manageable, release any retained reference.
+                self.backend.release_window(win);
+                false
+            }
+            None => true,
+        }
+    }
+
+    /// Tiles an admitted window on the display it opened on, in the upcoming pass.
+    fn place_window(&mut self, win: WindowId, pass: &mut PendingPass) {
+        let Some(monitor) = self.target_monitor(win) else {
+            log::warn!("No display available for {:?}", win);
+            self.backend.release_window(win);
+            return;
+        };
+        // Insert the window next to the focused one if both are on the same workspace.
+        if let Some(location) = self.monitors.insert_window(monitor, win, self.focused) {
+            pass.relayout.insert(location);
+        }
+    }
+
+    /// Puts discovered windows back into the trees of a saved session, in the upcoming pass,
+    /// and shows the workspaces that were shown. Returns the windows that are not part of
+    /// the session, to be placed as new ones.
+    fn restore_session(&mut self, session: Session, windows: Vec<WindowId>, pass: &mut PendingPass) -> Vec<WindowId> {
+        let started = Instant::now();
+        let keys: Vec<(WindowId, WindowKey)> = windows
+            .iter()
+            .filter_map(|&win| {
+                let pid = self.backend.window_pid(win)?;
+                Some((win, WindowKey::new(pid, self.backend.window_title(win), self.backend.opening_rect(win))))
+            })
+            .collect();
+        let matched = session.match_windows(&keys);
+
+        for saved in &session.displays {
+            // Display IDs may change across a restart; fall back to the same tiling area.
+            let monitor = self
+                .monitors
+                .display(MonitorId(saved.id))
+                .or_else(|| self.monitors.displays().find(|display| session::pack_rect(display.frame) == saved.frame))
+                .map(|display| display.id);
+            let Some(monitor) = monitor else {
+                continue;
+            };
+            let mut restored = false;
+            for workspace in &saved.workspaces {
+                let tree = BspTree::restore(&workspace.nodes, |window| matched.get(&window).copied());
+                let location = Location { monitor, workspace: workspace.index };
+                if tree.root.is_some() && self.monitors.restore(location, tree) {
+                    pass.relayout.insert(location);
+                    restored = true;
+                }
+            }
+            if restored {
+                self.switch_workspace(monitor, saved.active, pass);
+            }
+        }
+
+        let (restored, remaining): (Vec<WindowId>, Vec<WindowId>) =
+            windows.into_iter().partition(|&win| self.monitors.contains_window(win));
+        log::info!(
+            "Restored {} of {} window(s) from the previous session in {:?}",
+            restored.len(),
+            restored.len() + remaining.len(),
+            started.elapsed()
         );
+        remaining
+    }
+
+    /// Writes the trees to the session file if they changed since the last write.
+    /// Skipped until the windows found at startup have been placed, so a restart cannot
+    /// overwrite the session it is about to restore.
+    async fn save_session(&mut self) {
+        let Some(path) = self.session_path.clone() else {
+            return;
+        };
+        if !self.session_dirty || self.startup.is_some() {
+            return;
+        }
+        self.session_dirty = false;
+        let session = self.session_snapshot();
+        match tokio::task::spawn_blocking(move || session.save(&path)).await {
+            Ok(Ok(())) => log::trace!("Saved the session"),
+            Ok(Err(e)) => log::warn!("Failed to save the session: {}", e),
+            Err(e) => log::error!("Session save task failed: {}", e),
+        }
+    }
 
-        for (win, rect) in layouts {
-            // Tell the OS to move/resize the window.
-            if let Err(e) = self.backend.set_window_rect(win, rect) {
-                log::error!("Failed to set window rect for {:?}: {}", win, e);
+    /// Captures every tree with the keys that identify its windows after a restart.
+    /// Windows the backend cannot name a process for are left out.
+    fn session_snapshot(&self) -> Session {
+        let mut session = Session::new();
+        for display in self.monitors.displays() {
+            let mut workspaces = Vec::new();
+            for (index, workspace) in display.workspaces.iter().enumerate() {
+                if workspace.tree.root.is_none() {
+                    continue;
+                }
+                for win in workspace.tree.windows() {
+                    if let Some(pid) = self.backend.window_pid(win) {
+                        let key = WindowKey::new(pid, self.backend.window_title(win), self.applied.get(&win).copied());
+                        session.windows.insert(win.0, key);
+                    }
+                }
+                workspaces.push(SavedWorkspace { index, nodes: workspace.tree.saved_nodes() });
             }
+            session.displays.push(SavedDisplay {
+                id: display.id.0,
+                frame: session::pack_rect(display.frame),
+                active: display.active,
+                workspaces,
+            });
         }
+        session
     }
 
-    /// Synchronizes the current window manager state with all connected UI clients.
-    /// 
-    /// This converts the internal BSP tree state into a `UiState` and broadcasts it
-    /// via the `IpcServer`.
-    fn sync_ui(&self) {
-        // Use a default monitor size for coordinate normalization in the UI.
-        let monitor_rect = Rect::new(
-            euclid::default::Point2D::new(0, 0),
-            euclid::default::Size2D::new(1920, 1080)
-        );
+    /// Switches to a reloaded configuration, re-applying only the settings that changed.
+    fn apply_config(&mut self, config: Config, pass: &mut PendingPass) {
+        if config == self.config {
+            log::debug!("Configuration unchanged");
+            return;
+        }
+        let old = std::mem::replace(&mut self.config, config);
+        if (old.gap_inner, old.gap_outer) != (self.config.gap_inner, self.config.gap_outer) {
+            // Hidden workspaces are laid out too, so switching to them stays a move.
+            pass.relayout.extend(self.monitors.locations());
+        }
+        if old.max_tiles != self.config.max_tiles {
+            if self.config.max_tiles == 0 {
+                log::warn!("Ignoring max_tiles = 0; keeping {}", old.max_tiles);
+                self.config.max_tiles = old.max_tiles;
+            } else {
+                pass.relayout.extend(self.monitors.reset_max_tiles(self.config.max_tiles));
+            }
+        }
+        if old.rules != self.config.rules {
+            // Windows already known keep the rule result they were given when they appeared.
+            self.backend.set_rules(Arc::new(RuleSet::compile(&self.config.rules)));
+        }
+        if old.workspaces != self.config.workspaces {
+            log::warn!("The number of workspaces only changes after a restart");
+            self.config.workspaces = old.workspaces;
+        }
+        if old.layouts() != self.config.layouts() {
+            for (workspace, algorithm) in self.config.layouts().into_iter().enumerate() {
+                pass.relayout.extend(self.monitors.set_layout(workspace, algorithm).unwrap_or_default());
+            }
+        }
+        log::info!("Applied configuration changes");
+    }
 
-        // Calculate the current positions of all windows.
-        let layouts = self.tree.calculate_layout(
-            monitor_rect,
-            self.config.gap_inner,
-            self.config.gap_outer
-        );
+    /// Resolves a command's optional window argument, defaulting to the focused window.
+    fn command_target(&self, window: Option<u32>) -> Result<WindowId, String> {
+        window.map(WindowId).or(self.focused).ok_or_else(|| "no window given and none focused".to_string())
+    }
 
+    /// Records the work after a stack operation on `window`'s tile made `shown` visible.
+    fn stack_changed(&mut self, window: WindowId, shown: WindowId, pass: &mut PendingPass) {
+        if let Some(location) = self.monitors.location_of(window) {
+            pass.relayout.insert(location);
+            if self.monitors.is_shown(location) {
+                pass.raise.push(shown);
+            }
+        }
+    }
+
+    /// Reads the frames of the windows that stopped moving, off the async workers, and
+    /// queues those that are no longer where they were last sent to be put back.
+    async fn check_moved(&mut self, pass: &mut PendingPass) {
+        let now = Instant::now();
+        let settled: Vec<WindowId> =
+            self.moved.iter().filter(|(_, &moved)| now >= moved + MOVE_SETTLE).map(|(&win, _)| win).collect();
+        for win in &settled {
+            self.moved.remove(win);
+        }
+        let backend = self.backend.clone();
+        let read = tokio::task::spawn_blocking(move || {
+            settled.into_iter().map(|win| (win, backend.get_window_rect(win))).collect::<Vec<_>>()
+        })
+        .await;
+        let frames = match read {
+            Ok(frames) => frames,
+            Err(e) => {
+                log::error!("Frame read task failed: {}", e);
+                return;
+            }
+        };
+        for (win, frame) in frames {
+            let (Some(frame), Some(&applied)) = (frame, self.applied.get(&win)) else {
+                continue;
+            };
+            if frame == applied || self.restored.get(&win) == Some(&frame) {
+                continue;
+            }
+            log::debug!("{:?} was moved to {:?}; putting it back at {:?}", win, frame, applied);
+            self.restored.insert(win, frame);
+            pass.restore.insert(win);
+        }
+    }
+
+    /// Brings windows to the front of their tiles off the async workers.
+    async fn raise_windows(&self, windows: Vec<WindowId>) {
+        let backend = self.backend.clone();
+        let result = tokio::task::spawn_blocking(move || {
+            for window in windows {
+                if let Err(e) = backend.raise_window(window) {
+                    log::warn!("{}", e);
+                }
+            }
+        })
+        .await;
+        if let Err(e) = result {
+            log::error!("Raise task failed: {}", e);
+        }
+    }
+
+    /// Returns the display holding the focused window, or the primary display.
+    fn focused_monitor(&self) -> Option<MonitorId> {
+        self.focused.and_then(|f| self.monitors.display_of(f)).or_else(|| self.monitors.primary())
+    }
+
+    /// Shows `workspace` on `monitor` in the upcoming pass, if it is not shown already.
+    fn switch_workspace(&mut self, monitor: MonitorId, workspace: usize, pass: &mut PendingPass) {
+        if let Some(previous) = self.monitors.switch_workspace(monitor, workspace) {
+            log::debug!("Switching {:?} from workspace {} to {}", monitor, previous, workspace);
+            pass.switched.push((monitor, previous));
+            pass.switch_started.get_or_insert_with(Instant::now);
+        }
+    }
+
+    /// Picks the display for a new window: the one it opened on, else the focused window's,
+    /// else the primary display.
+    fn target_monitor(&self, window: WindowId) -> Option<MonitorId> {
+        self.backend
+            .opening_rect(window)
+            .and_then(|rect| self.monitors.display_at(rect.center()))
+            .or_else(|| self.focused.and_then(|f| self.monitors.display_of(f)))
+            .or_else(|| self.monitors.primary())
+    }
+
+    /// Updates the cached layout of the changed workspaces, publishes the shown ones as a new
+    /// snapshot, and applies the rectangles of windows that moved via the backend.
+    /// Returns the number of frames sent to the backend.
+    ///
+    /// Hidden workspaces are laid out too, with their windows parked off-screen at their
+    /// tiled size, so a later switch only has to move windows and never recomputes a tree.
+    async fn apply_layout(&mut self, pass: &PendingPass) -> usize {
+        // Later entries for a window override earlier ones, e.g. across several switches.
+        let mut targets: HashMap<WindowId, Rect> = HashMap::new();
+        let (gap_inner, gap_outer) = (self.config.gap_inner, self.config.gap_outer);
+        let started = Instant::now();
+        for display in self.monitors.displays_mut() {
+            for index in 0..display.workspaces.len() {
+                if !pass.relayout.contains(&Location { monitor: display.id, workspace: index }) {
+                    continue;
+                }
+                let workspace = &mut display.workspaces[index];
+                let layout = workspace.algorithm.layout();
+                let moved = workspace.tree.update_layout(layout, display.frame, gap_inner, gap_outer);
+                workspace.layout = workspace.tree.cached_layout();
+                let hidden = index != display.active;
+                for (win, rect) in moved {
+                    targets.insert(win, if hidden { display.hidden_rect(rect) } else { rect });
+                }
+            }
+        }
+
+        metrics().layout.record_duration(started.elapsed());
+
+        // The parking corner follows the display configuration, so windows of hidden
+        // workspaces are parked again; those that did not move are filtered out below.
+        if pass.monitors_changed {
+            for display in self.monitors.displays() {
+                for (index, workspace) in display.workspaces.iter().enumerate() {
+                    if index == display.active {
+                        continue;
+                    }
+                    for win in workspace.tree.windows() {
+                        if let Some(rect) = self.applied.get(&win) {
+                            targets.entry(win).or_insert_with(|| display.hidden_rect(*rect));
+                        }
+                    }
+                }
+            }
+        }
+
+        // A switch parks every window of the outgoing workspace, stacked ones included, and
+        // moves the incoming workspace's visible windows back to their precomputed tiles.
+        for &(monitor, previous) in &pass.switched {
+            let Some(display) = self.monitors.display(monitor) else {
+                continue;
+            };
+            let outgoing = &display.workspaces[previous];
+            for win in outgoing.tree.windows() {
+                if let Some(rect) = self.applied.get(&win) {
+                    targets.insert(win, display.hidden_rect(*rect));
+                }
+            }
+            for &(win, rect) in &display.active_workspace().layout {
+                targets.insert(win, rect);
+            }
+        }
+
+        // Windows moved by something else go back to their tile, or to the parking corner.
+        for &win in &pass.restore {
+            let Some(location) = self.monitors.location_of(win) else {
+                continue;
+            };
+            let Some(display) = self.monitors.display(location.monitor) else {
+                continue;
+            };
+            let layout = &display.workspaces[location.workspace].layout;
+            let Some(&(_, rect)) = layout.iter().find(|&&(visible, _)| visible == win) else {
+                continue;
+            };
+            let hidden = location.workspace != display.active;
+            targets.entry(win).or_insert(if hidden { display.hidden_rect(rect) } else { rect });
+            // The applied frame is no longer where the window is, so it must not filter it out.
+            self.applied.remove(&win);
+        }
+
+        // Only the workspace shown on each display is part of the snapshot.
+        self.snapshot = LayoutSnapshot {
+            version: self.snapshot.version + 1,
+            windows: Arc::new(
+                self.monitors
+                    .displays()
+                    .flat_map(|display| display.active_workspace().layout.iter().copied())
+                    .collect(),
+            ),
+        };
+        let moved = targets;
+
+        // Skip windows that already sit at this rectangle, and send only what changed.
+        let frames: Vec<_> = moved
+            .into_iter()
+            .filter_map(|(win, rect)| {
+                FrameChange::between(self.applied.get(&win).copied(), rect).map(|change| (win, rect, change))
+            })
+            .collect();
+        if frames.is_empty() {
+            return 0;
+        }
+
+        // Accessibility calls block on the target app, so keep them off the async workers.
+        let backend = self.backend.clone();
+        let batch = frames.clone();
+        let span = tracing::debug_span!("apply_frames", frames = frames.len());
+        let started = Instant::now();
+        let applied = tokio::task::spawn_blocking(move || span.in_scope(|| backend.apply_frames(&batch))).await;
+        metrics().apply_frames.record_duration(started.elapsed());
+        let failed = match applied {
+            Ok(failed) => failed,
+            Err(e) => {
+                log::error!("Frame application task failed: {}", e);
+                frames.iter().map(|frame| frame.0).collect()
+            }
+        };
+
+        let count = frames.len();
+        for (win, rect, _) in frames {
+            if failed.contains(&win) {
+                self.applied.remove(&win);
+            } else {
+                self.applied.insert(win, rect);
+            }
+        }
+        count
+    }
+
+    /// Synchronizes the current window manager state with all connected UI clients.
+    /// 
+    /// This converts the latest layout snapshot into a `UiState` and broadcasts it
+    /// via the `IpcServer`. The layout itself is never recomputed here.
+    fn sync_ui(&mut self, queue: QueueStats) {
+        let _span = tracing::debug_span!("broadcast", windows = self.snapshot.windows.len()).entered();
         // Convert the internal layout into a UI-friendly format.
-        let windows = layouts.into_iter().map(|(id, rect)| {
+        let windows = self.snapshot.windows.iter().map(|&(id, rect)| {
             WindowInfo {
                 id: id.0,
-                title: format!("Window {}", id.0), // TODO: Fetch actual window title from backend.
+                // Answered from the backend's cache, not by asking the application.
+                title: self.backend.window_title(id).unwrap_or_else(|| format!("Window {}", id.0)),
                 x: rect.min_x(),
                 y: rect.min_y(),
                 width: rect.width() as u32,
                 height: rect.height() as u32,
+                stacked: self.monitors.tree_of(id).map_or(0, |tree| tree.stack_size(id)),
+                monitor: self.monitors.display_of(id).map_or(0, |monitor| monitor.0),
+                workspace: self.monitors.location_of(id).map_or(0, |location| location.workspace),
             }
         }).collect();
 
         let state = UiState {
             windows,
-            focused_window: None, // TODO: Track focus in WindowManager.
+            focused_window: self.focused.map(|id| id.0),
+            stats: self.monitors.stats(),
+            queue,
+            // Assigned by the IPC server when the state is broadcast.
+            seq: 0,
         };
         // Push the new state to all connected IPC clients.
         self.ipc_server.broadcast_state(state);
+        self.broadcast_version = self.snapshot.version;
     }
 }
-
@@ -0,0 +1,165 @@
+//! Latency and queue depth histograms for the hot paths, reported by `GetMetrics`.
+//!
+//! Recording is a few relaxed atomic operations, cheap enough to stay on in release builds.
+//! Values fall into power-of-two buckets, so reported percentiles are upper bounds that are
+//! at most twice the true value.
+
+use serde::{Serialize, Deserialize};
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex, OnceLock};
+use std::time::Duration;
+
+/// Number of buckets: bucket `i` holds values of bit length `i`, so the last one holds
+/// everything from 2^30 up.
+const BUCKETS: usize = 32;
+
+/// A histogram of non-negative values.
+#[derive(Debug, Default)]
+pub struct Histogram {
+    /// Number of recorded values in each bucket.
+    buckets: [AtomicU64; BUCKETS],
+    /// Sum of all recorded values.
+    sum: AtomicU64,
+    /// The largest recorded value.
+    max: AtomicU64,
+}
+
+impl Histogram {
+    /// Records one value.
+    pub fn record(&self, value: u64) {
+        let bucket = ((u64::BITS - value.leading_zeros()) as usize).min(BUCKETS - 1);
+        self.buckets[bucket].fetch_add(1, Ordering::Relaxed);
+        self.sum.fetch_add(value, Ordering::Relaxed);
+        self.max.fetch_max(value, Ordering::Relaxed);
+    }
+
+    /// Records a duration in microseconds.
+    pub fn record_duration(&self, duration: Duration) {
+        self.record(duration.as_micros().min(u64::MAX as u128) as u64);
+    }
+
+    /// Reads the histogram's summary.
+    pub fn snapshot(&self) -> HistogramSnapshot {
+        let buckets: Vec<u64> = self.buckets.iter().map(|bucket| bucket.load(Ordering::Relaxed)).collect();
+        let count: u64 = buckets.iter().sum();
+        if count == 0 {
+            return HistogramSnapshot::default();
+        }
+        let max = self.max.load(Ordering::Relaxed);
+        let percentile = |fraction: f64| {
+            let rank = ((count as f64 * fraction).ceil() as u64).max(1);
+            let mut seen = 0;
+            for (bucket, &n) in buckets.iter().enumerate() {
+                seen += n;
+                if seen >= rank {
+                    // The largest value of bit length `bucket`.
+                    return ((1u64 << bucket) - 1).min(max);
+                }
+            }
+            max
+        };
+        HistogramSnapshot {
+            count,
+            mean: self.sum.load(Ordering::Relaxed) / count,
+            p50: percentile(0.50),
+            p90: percentile(0.90),
+            p99: percentile(0.99),
+            max,
+        }
+    }
+}
+
+/// A summary of a histogram. Durations are in microseconds.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct HistogramSnapshot {
+    /// Number of recorded values.
+    pub count: u64,
+    /// Average of the recorded values.
+    pub mean: u64,
+    /// Median, as a bucket upper bound.
+    pub p50: u64,
+    /// 90th percentile, as a bucket upper bound.
+    pub p90: u64,
+    /// 99th percentile, as a bucket upper bound.
+    pub p99: u64,
+    /// The largest recorded value.
+    pub max: u64,
+}
+
+/// The frame call latency of one application.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct AppMetrics {
+    /// The application's process.
+    pub pid: i32,
+    /// Time of each call moving or resizing one of its windows.
+    pub set_frame: HistogramSnapshot,
+}
+
+/// Every histogram, as reported by `GetMetrics`.
+#[derive(Debug, Clone, Default, Serialize, Deserialize)]
+pub struct MetricsSnapshot {
+    /// Time from the oldest event of a batch being queued to its frames being applied.
+    pub event_to_frame: HistogramSnapshot,
+    /// Events already waiting when the manager starts a batch.
+    pub queue_depth: HistogramSnapshot,
+    /// Time spent recomputing workspace layouts, per layout pass.
+    pub layout: HistogramSnapshot,
+    /// Time the backend took to apply the frames of a layout pass.
+    pub apply_frames: HistogramSnapshot,
+    /// Frame call latency of each application the backend has moved windows of.
+    pub apps: Vec<AppMetrics>,
+}
+
+/// The daemon's histograms. Shared by the manager and the backends; see `metrics()`.
+#[derive(Debug, Default)]
+pub struct Metrics {
+    /// See `MetricsSnapshot::event_to_frame`.
+    pub event_to_frame: Histogram,
+    /// See `MetricsSnapshot::queue_depth`.
+    pub queue_depth: Histogram,
+    /// See `MetricsSnapshot::layout`.
+    pub layout: Histogram,
+    /// See `MetricsSnapshot::apply_frames`.
+    pub apply_frames: Histogram,
+    /// Set-frame call latency by PID.
+    apps: Mutex<HashMap<i32, Arc<Histogram>>>,
+}
+
+/// Returns the process-wide metrics.
+pub fn metrics() -> &'static Metrics {
+    static METRICS: OnceLock<Metrics> = OnceLock::new();
+    METRICS.get_or_init(Metrics::default)
+}
+
+impl Metrics {
+    /// Returns the set-frame histogram of an application. Callers moving several windows
+    /// look it up once and record into it without taking the lock again.
+    pub fn app(&self, pid: i32) -> Arc<Histogram> {
+        self.apps.lock().unwrap().entry(pid).or_default().clone()
+    }
+
+    /// Drops the histogram of an application that terminated.
+    pub fn forget_app(&self, pid: i32) {
+        self.apps.lock().unwrap().remove(&pid);
+    }
+
+    /// Reads every histogram.
+    pub fn snapshot(&self) -> MetricsSnapshot {
+        let mut apps: Vec<AppMetrics> = self
+            .apps
+            .lock()
+            .unwrap()
+            .iter()
+            .map(|(&pid, histogram)| AppMetrics { pid, set_frame: histogram.snapshot() })
+            .collect();
+        apps.sort_by_key(|app| app.pid);
+        MetricsSnapshot {
+            event_to_frame: self.event_to_frame.snapshot(),
+            queue_depth: self.queue_depth.snapshot(),
+            layout: self.layout.snapshot(),
+            apply_frames: self.apply_frames.snapshot(),
+            apps,
+        }
+    }
+}
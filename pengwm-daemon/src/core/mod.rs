@@ -6,4 +6,11 @@
 pub mod types;
 pub mod geometry;
 pub mod bsp;
+pub mod layout;
+pub mod layout_cache;
+pub mod monitor;
 pub mod manager;
+pub mod queue;
+pub mod metrics;
+pub mod recording;
+pub mod session;
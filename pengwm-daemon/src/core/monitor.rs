@@ -0,0 +1,398 @@
+//! Registry of connected displays and their workspaces.
+//!
+//! Caches the frame of every display and owns one BSP tree per workspace of each display.
+//! The OS is only asked for display geometry when it reports a configuration change, and a
+//! change on one workspace only re-tiles that workspace.
+
+use crate::core::bsp::{BspTree, TreeStats};
+use crate::core::geometry::{Point, Rect};
+use crate::core::layout::LayoutKind;
+use crate::core::types::{MonitorId, WindowId};
+use std::collections::HashMap;
+
+/// Where a managed window lives.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct Location {
+    /// The display holding the window.
+    pub monitor: MonitorId,
+    /// Index of the workspace on that display.
+    pub workspace: usize,
+}
+
+/// One workspace of a display: its tree and the layout last computed for it.
+pub struct Workspace {
+    /// The windows tiled on this workspace.
+    pub tree: BspTree,
+    /// Visible windows with their rectangles from the last layout pass of this workspace.
+    /// Kept up to date while the workspace is hidden, so switching to it needs no layout pass.
+    pub layout: Vec<(WindowId, Rect)>,
+    /// The algorithm arranging the tree's windows.
+    pub algorithm: LayoutKind,
+}
+
+/// A connected display and its workspaces.
+pub struct Display {
+    /// The OS identifier of the display.
+    pub id: MonitorId,
+    /// The area available for tiling, in global screen coordinates.
+    pub frame: Rect,
+    /// Every workspace of the display, always at least one.
+    pub workspaces: Vec<Workspace>,
+    /// Index of the workspace currently shown.
+    pub active: usize,
+    /// Where windows of hidden workspaces are parked: the bottom-right corner of the area
+    /// covered by all displays, so no part of them lands on any display.
+    parking: Point,
+}
+
+impl Display {
+    /// Creates a display with one empty workspace per entry of `layouts`, showing the first.
+    fn new(id: MonitorId, frame: Rect, layouts: &[LayoutKind]) -> Self {
+        Self {
+            id,
+            frame,
+            workspaces: layouts
+                .iter()
+                .map(|&algorithm| Workspace { tree: BspTree::new(), layout: Vec::new(), algorithm })
+                .collect(),
+            active: 0,
+            parking: Point::new(frame.max_x(), frame.max_y()),
+        }
+    }
+
+    /// Returns the workspace currently shown.
+    pub fn active_workspace(&self) -> &Workspace {
+        &self.workspaces[self.active]
+    }
+
+    /// Returns where windows are parked while their workspace is hidden: past the bottom-right
+    /// corner of every display, keeping their size so showing them again is a move.
+    pub fn hidden_rect(&self, rect: Rect) -> Rect {
+        Rect::new(self.parking, rect.size)
+    }
+}
+
+/// All connected displays, with the primary display first.
+pub struct MonitorRegistry {
+    /// Connected displays in the order reported by the backend, primary first.
+    displays: Vec<Display>,
+    /// Maps every managed window to the workspace whose tree holds it.
+    locations: HashMap<WindowId, Location>,
+    /// The tile limit of each workspace index, shared by all displays.
+    max_tiles: Vec<usize>,
+    /// The layout algorithm of each workspace index, shared by all displays.
+    layouts: Vec<LayoutKind>,
+}
+
+impl MonitorRegistry {
+    /// Creates a registry with no displays, giving each display one workspace per entry of
+    /// `layouts` (at least one).
+    pub fn new(max_tiles: usize, mut layouts: Vec<LayoutKind>) -> Self {
+        if layouts.is_empty() {
+            layouts.push(LayoutKind::default());
+        }
+        Self {
+            displays: Vec::new(),
+            locations: HashMap::new(),
+            max_tiles: vec![max_tiles; layouts.len()],
+            layouts,
+        }
+    }
+
+    /// Replaces the cached display list with `monitors` (primary first).
+    ///
+    /// Trees of displays that are still connected are kept. Windows of disconnected displays
+    /// move to the same workspace on the primary display. Returns the workspaces that need a
+    /// layout pass: those of new displays, of displays whose frame changed, and those that
+    /// received windows.
+    pub fn update(&mut self, monitors: Vec<(MonitorId, Rect)>) -> Vec<Location> {
+        if monitors.is_empty() {
+            log::warn!("Backend reported no displays; keeping the previous configuration");
+            return Vec::new();
+        }
+
+        let mut previous: HashMap<MonitorId, Display> =
+            self.displays.drain(..).map(|display| (display.id, display)).collect();
+        let mut changed = Vec::new();
+        for (id, frame) in monitors {
+            let display = match previous.remove(&id) {
+                Some(mut display) => {
+                    if display.frame != frame {
+                        log::info!("Display {:?} changed to {:?}", id, frame);
+                        display.frame = frame;
+                        changed.push(id);
+                    }
+                    display
+                }
+                None => {
+                    log::info!("Display {:?} connected at {:?}", id, frame);
+                    changed.push(id);
+                    Display::new(id, frame, &self.layouts)
+                }
+            };
+            self.displays.push(display);
+        }
+        let parking = Point::new(
+            self.displays.iter().map(|display| display.frame.max_x()).max().unwrap_or_default(),
+            self.displays.iter().map(|display| display.frame.max_y()).max().unwrap_or_default(),
+        );
+        for display in &mut self.displays {
+            display.parking = parking;
+        }
+        let mut changed: Vec<Location> = changed
+            .into_iter()
+            .flat_map(|monitor| (0..self.max_tiles.len()).map(move |workspace| Location { monitor, workspace }))
+            .collect();
+
+        // Anything left in `previous` was disconnected.
+        let primary = self.displays[0].id;
+        for (id, display) in previous {
+            log::info!("Display {:?} disconnected, moving its windows to {:?}", id, primary);
+            for (workspace, old) in display.workspaces.iter().enumerate() {
+                let mut orphans: Vec<WindowId> = old.tree.windows().collect();
+                if orphans.is_empty() {
+                    continue;
+                }
+                orphans.sort_by_key(|window| window.0);
+                let target = Location { monitor: primary, workspace };
+                let tree = &mut self.displays[0].workspaces[workspace].tree;
+                let layout = self.layouts[workspace].layout();
+                for window in orphans {
+                    tree.insert_window(window, None, self.max_tiles[workspace], layout);
+                    self.locations.insert(window, target);
+                }
+                if !changed.contains(&target) {
+                    changed.push(target);
+                }
+            }
+        }
+        changed
+    }
+
+    /// Returns the location of every workspace of every connected display.
+    pub fn locations(&self) -> impl Iterator<Item = Location> + '_ {
+        self.displays.iter().flat_map(|display| {
+            (0..display.workspaces.len()).map(move |workspace| Location { monitor: display.id, workspace })
+        })
+    }
+
+    /// Returns every connected display, primary first.
+    pub fn displays(&self) -> impl Iterator<Item = &Display> {
+        self.displays.iter()
+    }
+
+    /// Returns every connected display for modification, primary first.
+    pub fn displays_mut(&mut self) -> impl Iterator<Item = &mut Display> {
+        self.displays.iter_mut()
+    }
+
+    /// Looks up a connected display.
+    pub fn display(&self, id: MonitorId) -> Option<&Display> {
+        self.displays.iter().find(|display| display.id == id)
+    }
+
+    /// Returns the primary display, if any display is connected.
+    pub fn primary(&self) -> Option<MonitorId> {
+        self.displays.first().map(|display| display.id)
+    }
+
+    /// Returns the display whose frame contains `point`.
+    pub fn display_at(&self, point: Point) -> Option<MonitorId> {
+        self.displays.iter().find(|display| display.frame.contains(point)).map(|display| display.id)
+    }
+
+    /// Returns where `window` lives, if it is managed.
+    pub fn location_of(&self, window: WindowId) -> Option<Location> {
+        self.locations.get(&window).copied()
+    }
+
+    /// Returns the display holding `window`, if it is managed.
+    pub fn display_of(&self, window: WindowId) -> Option<MonitorId> {
+        self.location_of(window).map(|location| location.monitor)
+    }
+
+    /// Returns the tree holding `window`, if it is managed.
+    pub fn tree_of(&self, window: WindowId) -> Option<&BspTree> {
+        let location = self.location_of(window)?;
+        self.workspace(location).map(|workspace| &workspace.tree)
+    }
+
+    /// Returns the tree holding `window` for modification, if it is managed.
+    pub fn tree_of_mut(&mut self, window: WindowId) -> Option<&mut BspTree> {
+        let location = self.location_of(window)?;
+        self.workspace_mut(location).map(|workspace| &mut workspace.tree)
+    }
+
+    /// Checks if a window is managed on any display.
+    pub fn contains_window(&self, window: WindowId) -> bool {
+        self.locations.contains_key(&window)
+    }
+
+    /// Checks if `location` is the workspace currently shown on its display.
+    pub fn is_shown(&self, location: Location) -> bool {
+        self.display(location.monitor).is_some_and(|display| display.active == location.workspace)
+    }
+
+    /// Inserts a window into the active workspace of `monitor`, next to `focused` if it is
+    /// in the same workspace. Returns where the window was placed, or `None` if the display
+    /// is not connected.
+    pub fn insert_window(&mut self, monitor: MonitorId, window: WindowId, focused: Option<WindowId>) -> Option<Location> {
+        let workspace = self.display(monitor)?.active;
+        let location = Location { monitor, workspace };
+        self.insert_at(location, window, focused);
+        Some(location)
+    }
+
+    /// Removes a window from whichever workspace holds it, returning that workspace.
+    pub fn remove_window(&mut self, window: WindowId) -> Option<Location> {
+        let location = self.locations.remove(&window)?;
+        if let Some(workspace) = self.workspace_mut(location) {
+            workspace.tree.remove_window(window);
+        }
+        Some(location)
+    }
+
+    /// Moves a window to another workspace of the same display.
+    /// Returns the workspace it left, or `None` if it is unmanaged, already there, or
+    /// `workspace` does not exist.
+    pub fn move_window(&mut self, window: WindowId, workspace: usize) -> Option<Location> {
+        let from = self.location_of(window)?;
+        if from.workspace == workspace || workspace >= self.max_tiles.len() {
+            return None;
+        }
+        self.remove_window(window);
+        self.insert_at(Location { monitor: from.monitor, workspace }, window, None);
+        Some(from)
+    }
+
+    /// Makes `workspace` the one shown on `monitor`, returning the workspace it replaces.
+    /// Returns `None` if the display is unknown, the workspace does not exist, or it is already shown.
+    pub fn switch_workspace(&mut self, monitor: MonitorId, workspace: usize) -> Option<usize> {
+        let display = self.displays.iter_mut().find(|display| display.id == monitor)?;
+        if workspace >= display.workspaces.len() || workspace == display.active {
+            return None;
+        }
+        Some(std::mem::replace(&mut display.active, workspace))
+    }
+
+    /// Sets the tile limit of a workspace index on every display and re-applies the overflow
+    /// strategy to its trees. Returns the workspaces whose tiles changed, or `None` if
+    /// `workspace` does not exist.
+    pub fn set_max_tiles(&mut self, workspace: usize, limit: usize) -> Option<Vec<Location>> {
+        let current = self.max_tiles.get_mut(workspace)?;
+        if *current == limit {
+            return Some(Vec::new());
+        }
+        *current = limit;
+        let layout = self.layouts[workspace].layout();
+        let mut changed = Vec::new();
+        for display in &mut self.displays {
+            if display.workspaces[workspace].tree.reflow(limit, layout) {
+                changed.push(Location { monitor: display.id, workspace });
+            }
+        }
+        Some(changed)
+    }
+
+    /// Sets the tile limit of every workspace to `limit`.
+    /// Returns the workspaces whose tiles changed.
+    pub fn reset_max_tiles(&mut self, limit: usize) -> Vec<Location> {
+        (0..self.max_tiles.len())
+            .filter_map(|workspace| self.set_max_tiles(workspace, limit))
+            .flatten()
+            .collect()
+    }
+
+    /// Switches a workspace index to another layout algorithm on every display.
+    /// Returns the workspaces to lay out again, or `None` if `workspace` does not exist.
+    pub fn set_layout(&mut self, workspace: usize, algorithm: LayoutKind) -> Option<Vec<Location>> {
+        let current = self.layouts.get_mut(workspace)?;
+        if *current == algorithm {
+            return Some(Vec::new());
+        }
+        *current = algorithm;
+        let mut changed = Vec::new();
+        for display in &mut self.displays {
+            let target = &mut display.workspaces[workspace];
+            target.algorithm = algorithm;
+            target.tree.invalidate_layout();
+            changed.push(Location { monitor: display.id, workspace });
+        }
+        Some(changed)
+    }
+
+    /// Installs a tree restored from a saved session as a workspace's tree, folding it into
+    /// the workspace's current tile limit. Returns `false`, leaving the tree's windows
+    /// unplaced, if the workspace does not exist or already holds windows.
+    pub fn restore(&mut self, location: Location, mut tree: BspTree) -> bool {
+        let Some(&limit) = self.max_tiles.get(location.workspace) else {
+            return false;
+        };
+        if self.workspace(location).map_or(true, |workspace| workspace.tree.root.is_some()) {
+            return false;
+        }
+        tree.reflow(limit, self.layouts[location.workspace].layout());
+        for window in tree.windows() {
+            self.locations.insert(window, location);
+        }
+        if let Some(workspace) = self.workspace_mut(location) {
+            workspace.tree = tree;
+        }
+        true
+    }
+
+    /// Returns the shape counters of all trees combined; `depth` is the deepest tree's.
+    pub fn stats(&self) -> TreeStats {
+        self.displays
+            .iter()
+            .flat_map(|display| display.workspaces.iter())
+            .map(|workspace| workspace.tree.stats())
+            .fold(TreeStats::default(), |acc, stats| TreeStats {
+                leaves: acc.leaves + stats.leaves,
+                windows: acc.windows + stats.windows,
+                stacked: acc.stacked + stats.stacked,
+                depth: acc.depth.max(stats.depth),
+                arena_nodes: acc.arena_nodes + stats.arena_nodes,
+                live_nodes: acc.live_nodes + stats.live_nodes,
+            })
+    }
+
+    /// Compacts every tree whose arena has accumulated enough unused nodes.
+    /// Returns the number of trees compacted.
+    pub fn compact(&mut self) -> usize {
+        let mut compacted = 0;
+        for workspace in self.displays.iter_mut().flat_map(|display| display.workspaces.iter_mut()) {
+            if workspace.tree.needs_compaction() {
+                workspace.tree.compact();
+                compacted += 1;
+            }
+        }
+        compacted
+    }
+
+    /// Looks up a workspace.
+    pub fn workspace(&self, location: Location) -> Option<&Workspace> {
+        self.display(location.monitor)?.workspaces.get(location.workspace)
+    }
+
+    /// Looks up a workspace for modification.
+    fn workspace_mut(&mut self, location: Location) -> Option<&mut Workspace> {
+        self.displays
+            .iter_mut()
+            .find(|display| display.id == location.monitor)?
+            .workspaces
+            .get_mut(location.workspace)
+    }
+
+    /// Inserts a window into a specific workspace, next to `focused` if it is in the same tree.
+    fn insert_at(&mut self, location: Location, window: WindowId, focused: Option<WindowId>) {
+        let limit = self.max_tiles[location.workspace];
+        let layout = self.layouts[location.workspace].layout();
+        let Some(workspace) = self.workspace_mut(location) else {
+            return;
+        };
+        let focused_node = focused.and_then(|f| workspace.tree.find_window(f));
+        workspace.tree.insert_window(window, focused_node, limit, layout);
+        self.locations.insert(window, location);
+    }
+}
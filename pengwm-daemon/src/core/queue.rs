@@ -0,0 +1,146 @@
+//! Event queue between the platform backends and the window manager.
+//!
+//! Backends push events from OS callback threads that must never block, so the queue
+//! is unbounded (a lock-free linked list of blocks) and metered instead of capped:
+//! nothing is dropped while the manager is alive, and the depth is visible over IPC.
+//! Events are stamped when queued, so the manager can tell how long a batch waited.
+
+use crate::core::recording::Recorder;
+use crate::core::types::SystemEvent;
+use serde::{Serialize, Deserialize};
+use std::sync::Arc;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::Instant;
+use tokio::sync::mpsc::{self, UnboundedReceiver, UnboundedSender};
+
+/// Queue depth above which a saturation warning is logged.
+const DEPTH_WARNING: u64 = 1024;
+
+/// A snapshot of the event queue counters.
+#[derive(Debug, Clone, Copy, Default, Serialize, Deserialize)]
+pub struct QueueStats {
+    /// Events currently waiting to be processed.
+    pub queued: u64,
+    /// Events pushed since startup.
+    pub enqueued: u64,
+    /// Events that could not be delivered because the window manager had stopped.
+    pub dropped: u64,
+    /// The largest queue depth observed since startup.
+    pub high_water: u64,
+}
+
+/// Shared counters updated by both ends of the queue.
+#[derive(Debug, Default)]
+struct Meter {
+    enqueued: AtomicU64,
+    dequeued: AtomicU64,
+    dropped: AtomicU64,
+    high_water: AtomicU64,
+}
+
+impl Meter {
+    /// Reads all counters into a snapshot.
+    fn stats(&self) -> QueueStats {
+        let enqueued = self.enqueued.load(Ordering::Relaxed);
+        let dequeued = self.dequeued.load(Ordering::Relaxed);
+        QueueStats {
+            queued: enqueued.saturating_sub(dequeued),
+            enqueued,
+            dropped: self.dropped.load(Ordering::Relaxed),
+            high_water: self.high_water.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// The producing end of the event queue, handed to platform backends.
+#[derive(Debug, Clone)]
+pub struct EventSender {
+    tx: UnboundedSender<(SystemEvent, Instant)>,
+    meter: Arc<Meter>,
+    /// Also writes every queued event to a recording, if set.
+    recorder: Option<Arc<Recorder>>,
+}
+
+impl EventSender {
+    /// Records every event queued from now on, by this sender and its clones.
+    pub fn recorded(mut self, recorder: Recorder) -> Self {
+        self.recorder = Some(Arc::new(recorder));
+        self
+    }
+
+    /// Returns the current queue counters.
+    pub fn stats(&self) -> QueueStats {
+        self.meter.stats()
+    }
+
+    /// Queues an event without blocking.
+    /// Returns `false` if the window manager is gone and the event was dropped.
+    pub fn send(&self, event: SystemEvent) -> bool {
+        if let Some(recorder) = &self.recorder {
+            recorder.record(&event);
+        }
+        if self.tx.send((event, Instant::now())).is_err() {
+            self.meter.dropped.fetch_add(1, Ordering::Relaxed);
+            return false;
+        }
+
+        let enqueued = self.meter.enqueued.fetch_add(1, Ordering::Relaxed) + 1;
+        let depth = enqueued.saturating_sub(self.meter.dequeued.load(Ordering::Relaxed));
+        let previous = self.meter.high_water.fetch_max(depth, Ordering::Relaxed);
+        if depth > previous && depth == DEPTH_WARNING {
+            log::warn!("Event queue depth reached {}; the window manager is falling behind", depth);
+        }
+        true
+    }
+}
+
+/// The consuming end of the event queue, owned by the window manager.
+#[derive(Debug)]
+pub struct EventReceiver {
+    rx: UnboundedReceiver<(SystemEvent, Instant)>,
+    meter: Arc<Meter>,
+    /// When the oldest event received since the last `take_oldest` was queued.
+    oldest: Option<Instant>,
+}
+
+impl EventReceiver {
+    /// Waits for the next event. Returns `None` once every sender has been dropped.
+    pub async fn recv(&mut self) -> Option<SystemEvent> {
+        let event = self.rx.recv().await;
+        self.received(event)
+    }
+
+    /// Takes the next event if one is already queued.
+    pub fn try_recv(&mut self) -> Option<SystemEvent> {
+        let event = self.rx.try_recv().ok();
+        self.received(event)
+    }
+
+    /// Returns when the oldest event received since the previous call was queued.
+    pub fn take_oldest(&mut self) -> Option<Instant> {
+        self.oldest.take()
+    }
+
+    /// Counts a received event and unwraps it.
+    fn received(&mut self, event: Option<(SystemEvent, Instant)>) -> Option<SystemEvent> {
+        let (event, queued) = event?;
+        self.meter.dequeued.fetch_add(1, Ordering::Relaxed);
+        self.oldest.get_or_insert(queued);
+        Some(event)
+    }
+
+    /// Returns the current queue counters.
+    pub fn stats(&self) -> QueueStats {
+        self.meter.stats()
+    }
+}
+
+/// Creates a connected sender/receiver pair.
+pub fn event_queue() -> (EventSender, EventReceiver) {
+    let (tx, rx) = mpsc::unbounded_channel();
+    let meter = Arc::new(Meter::default());
+    (
+        EventSender { tx, meter: meter.clone(), recorder: None },
+        EventReceiver { rx, meter, oldest: None },
+    )
+}
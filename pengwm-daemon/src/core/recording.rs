@@ -0,0 +1,134 @@
+//! Recording of the backend's event stream, and reading it back for `replay`.
+//!
+//! A recording is a JSON Lines file: the displays reported when recording started, then one
+//! line per `SystemEvent` with its time since the start. Lines are written by a background
+//! thread, so recording never blocks the OS callback threads that queue events.
+
+use crate::core::geometry::{Point, Rect, Size};
+use crate::core::types::{MonitorId, SystemEvent};
+use serde::{Serialize, Deserialize};
+use std::fs::File;
+use std::io::{BufRead, BufReader, BufWriter, Write};
+use std::path::Path;
+use std::sync::mpsc as std_mpsc;
+use std::thread;
+use std::time::{Duration, Instant};
+
+/// A display as stored in a recording.
+#[derive(Debug, Clone, Copy, Serialize, Deserialize)]
+pub struct RecordedDisplay {
+    /// The backend's identifier of the display.
+    pub id: usize,
+    /// Left edge of the tiling area.
+    pub x: i32,
+    /// Top edge of the tiling area.
+    pub y: i32,
+    /// Width of the tiling area.
+    pub width: i32,
+    /// Height of the tiling area.
+    pub height: i32,
+}
+
+impl RecordedDisplay {
+    /// Returns the display as the backend reports it.
+    pub fn monitor(&self) -> (MonitorId, Rect) {
+        (MonitorId(self.id), Rect::new(Point::new(self.x, self.y), Size::new(self.width, self.height)))
+    }
+}
+
+impl From<&(MonitorId, Rect)> for RecordedDisplay {
+    fn from(&(id, rect): &(MonitorId, Rect)) -> Self {
+        Self { id: id.0, x: rect.min_x(), y: rect.min_y(), width: rect.width(), height: rect.height() }
+    }
+}
+
+/// One line of a recording.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+#[serde(tag = "type")]
+pub enum RecordEntry {
+    /// The displays connected when recording started. Always the first line.
+    Displays { displays: Vec<RecordedDisplay> },
+    /// An event queued `at_us` microseconds after recording started.
+    Event { at_us: u64, event: SystemEvent },
+}
+
+/// Writes every event queued through an `EventSender` to a recording.
+#[derive(Debug)]
+pub struct Recorder {
+    /// When recording started; event times are relative to it.
+    started: Instant,
+    /// Lines waiting for the writer thread.
+    tx: std_mpsc::Sender<RecordEntry>,
+}
+
+impl Recorder {
+    /// Creates the recording file, writes the displays and starts the writer thread.
+    pub fn create(path: impl AsRef<Path>, monitors: &[(MonitorId, Rect)]) -> std::io::Result<Self> {
+        let mut writer = BufWriter::new(File::create(path)?);
+        let header = RecordEntry::Displays { displays: monitors.iter().map(RecordedDisplay::from).collect() };
+        write_entry(&mut writer, &header)?;
+        writer.flush()?;
+
+        let (tx, rx) = std_mpsc::channel::<RecordEntry>();
+        thread::Builder::new().name("pengwm-recorder".into()).spawn(move || {
+            // Flushed once the queue runs dry, so a recording is complete up to the last
+            // quiet moment even if the daemon is killed.
+            while let Ok(entry) = rx.recv() {
+                let mut result = write_entry(&mut writer, &entry);
+                while let (Ok(()), Ok(entry)) = (&result, rx.try_recv()) {
+                    result = write_entry(&mut writer, &entry);
+                }
+                if let Err(e) = result.and_then(|()| writer.flush()) {
+                    log::error!("Stopped recording events: {}", e);
+                    return;
+                }
+            }
+        })?;
+        Ok(Self { started: Instant::now(), tx })
+    }
+
+    /// Queues an event for writing.
+    pub fn record(&self, event: &SystemEvent) {
+        let at_us = self.started.elapsed().as_micros() as u64;
+        let _ = self.tx.send(RecordEntry::Event { at_us, event: event.clone() });
+    }
+}
+
+/// Writes one line of a recording.
+fn write_entry(writer: &mut impl Write, entry: &RecordEntry) -> std::io::Result<()> {
+    serde_json::to_writer(&mut *writer, entry)?;
+    writer.write_all(b"\n")
+}
+
+/// A recording read back from a file.
+#[derive(Debug, Clone, Default)]
+pub struct Recording {
+    /// The displays connected when recording started.
+    pub monitors: Vec<(MonitorId, Rect)>,
+    /// Every recorded event with its time since the start, in order.
+    pub events: Vec<(Duration, SystemEvent)>,
+}
+
+impl Recording {
+    /// Reads a recording. Fails on the first line that cannot be parsed.
+    pub fn load(path: impl AsRef<Path>) -> anyhow::Result<Self> {
+        let mut recording = Self::default();
+        for (number, line) in BufReader::new(File::open(path)?).lines().enumerate() {
+            let line = line?;
+            if line.trim().is_empty() {
+                continue;
+            }
+            let entry: RecordEntry = serde_json::from_str(&line)
+                .map_err(|e| anyhow::anyhow!("line {}: {}", number + 1, e))?;
+            match entry {
+                RecordEntry::Displays { displays } => {
+                    recording.monitors = displays.iter().map(RecordedDisplay::monitor).collect();
+                }
+                RecordEntry::Event { at_us, event } => {
+                    recording.events.push((Duration::from_micros(at_us), event));
+                }
+            }
+        }
+        Ok(recording)
+    }
+}
@@ -0,0 +1,211 @@
+//! Snapshots of the window trees, restored when the daemon restarts.
+//!
+//! Window IDs do not survive a restart, so every window is saved with a key the next process
+//! can compute again: its PID, title and frame. Trees are saved as their nodes in pre-order,
+//! which is unambiguous because every split has exactly two children. The file lives in the
+//! temporary directory: after a reboot the PIDs it holds mean nothing anyway.
+
+use crate::core::bsp::NodeData;
+use crate::core::geometry::Rect;
+use crate::core::types::WindowId;
+use serde::{Serialize, Deserialize};
+use std::collections::{HashMap, HashSet};
+use std::fs;
+use std::io::ErrorKind;
+use std::path::{Path, PathBuf};
+
+/// Name of the snapshot file in the temporary directory.
+pub const SESSION_FILE: &str = "pengwm-session.json";
+
+/// Format of the snapshot file; snapshots written in another format are ignored.
+const SESSION_VERSION: u32 = 1;
+
+/// Returns the default location of the snapshot file.
+pub fn default_path() -> PathBuf {
+    std::env::temp_dir().join(SESSION_FILE)
+}
+
+/// Returns the origin and size of a rectangle, as saved.
+pub fn pack_rect(rect: Rect) -> [i32; 4] {
+    [rect.min_x(), rect.min_y(), rect.width(), rect.height()]
+}
+
+/// What identifies a window across a restart of the daemon.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct WindowKey {
+    /// The owning process.
+    pub pid: i32,
+    /// The window title.
+    pub title: String,
+    /// Origin and size of the window's frame, if known.
+    pub frame: Option<[i32; 4]>,
+}
+
+impl WindowKey {
+    /// Creates a key from what the backend reports about a window.
+    pub fn new(pid: i32, title: Option<String>, frame: Option<Rect>) -> Self {
+        Self {
+            pid,
+            title: title.unwrap_or_default(),
+            frame: frame.map(pack_rect),
+        }
+    }
+
+    /// Rates how well a saved key describes a live window: 0 for a different process, then
+    /// 1 for the same process only, 2 for the same frame, 3 for the same title, 4 for both.
+    /// Titles change less often than frames, which the user may have dragged.
+    fn similarity(&self, live: &WindowKey) -> u32 {
+        if self.pid != live.pid {
+            return 0;
+        }
+        let frame = self.frame.is_some() && self.frame == live.frame;
+        1 + u32::from(frame) + 2 * u32::from(self.title == live.title)
+    }
+}
+
+/// A saved workspace that held windows.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct SavedWorkspace {
+    /// Index of the workspace on its display.
+    pub index: usize,
+    /// The tree's nodes in pre-order.
+    pub nodes: Vec<NodeData>,
+}
+
+/// A saved display.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct SavedDisplay {
+    /// The backend's identifier of the display.
+    pub id: usize,
+    /// Origin and size of the display's tiling area, used when its identifier changed.
+    pub frame: [i32; 4],
+    /// Index of the workspace that was shown.
+    pub active: usize,
+    /// Its workspaces that held windows.
+    pub workspaces: Vec<SavedWorkspace>,
+}
+
+/// A snapshot of every tree.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct Session {
+    /// Format of the snapshot.
+    pub version: u32,
+    /// Every connected display.
+    pub displays: Vec<SavedDisplay>,
+    /// The key of every window referenced by the trees, by the ID it had when saved.
+    pub windows: HashMap<u32, WindowKey>,
+}
+
+impl Session {
+    /// Creates an empty snapshot.
+    pub fn new() -> Self {
+        Self { version: SESSION_VERSION, displays: Vec::new(), windows: HashMap::new() }
+    }
+
+    /// Reads a snapshot. Returns `None` if there is none, or it cannot be used.
+    pub fn load(path: &Path) -> Option<Self> {
+        let content = match fs::read(path) {
+            Ok(content) => content,
+            Err(e) if e.kind() == ErrorKind::NotFound => return None,
+            Err(e) => {
+                log::warn!("Failed to read {}: {}", path.display(), e);
+                return None;
+            }
+        };
+        match serde_json::from_slice::<Session>(&content) {
+            Ok(session) if session.version == SESSION_VERSION => Some(session),
+            Ok(session) => {
+                log::info!("Ignoring {} in format {}", path.display(), session.version);
+                None
+            }
+            Err(e) => {
+                log::warn!("Failed to parse {}: {}", path.display(), e);
+                None
+            }
+        }
+    }
+
+    /// Writes the snapshot next to `path` and renames it into place, so a crash while
+    /// writing leaves the previous snapshot intact. The file is not synced to disk: a crash
+    /// of the whole system invalidates the PIDs it holds.
+    pub fn save(&self, path: &Path) -> std::io::Result<()> {
+        let temporary = path.with_extension("json.tmp");
+        fs::write(&temporary, serde_json::to_vec(self)?)?;
+        fs::rename(&temporary, path)
+    }
+
+    /// Pairs saved windows with live ones, most similar pairs first; each window is used at
+    /// most once. Returns the live window of each matched saved ID.
+    pub fn match_windows(&self, live: &[(WindowId, WindowKey)]) -> HashMap<WindowId, WindowId> {
+        let mut candidates: Vec<(u32, WindowId, WindowId)> = Vec::new();
+        for (&saved, key) in &self.windows {
+            for (window, live_key) in live {
+                let similarity = key.similarity(live_key);
+                if similarity > 0 {
+                    candidates.push((similarity, WindowId(saved), *window));
+                }
+            }
+        }
+        // Ties are broken by ID, so the same inputs always give the same pairs.
+        candidates.sort_unstable_by(|a, b| b.0.cmp(&a.0).then(a.1 .0.cmp(&b.1 .0)).then(a.2 .0.cmp(&b.2 .0)));
+
+        let mut matched = HashMap::new();
+        let mut taken = HashSet::new();
+        for (_, saved, window) in candidates {
+            if !matched.contains_key(&saved) && !taken.contains(&window) {
+                matched.insert(saved, window);
+                taken.insert(window);
+            }
+        }
+        matched
+    }
+}
+
+impl Default for Session {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::core::geometry::{Point, Size};
+
+    /// A key of a window of process `pid`.
+    fn key(pid: i32, title: &str, frame: Option<(i32, i32)>) -> WindowKey {
+        let frame = frame.map(|(x, y)| Rect::new(Point::new(x, y), Size::new(800, 600)));
+        WindowKey::new(pid, Some(title.to_string()), frame)
+    }
+
+    #[test]
+    fn windows_of_one_process_pair_one_to_one() {
+        let mut session = Session::new();
+        session.windows.insert(1, key(10, "Inbox", Some((0, 0))));
+        session.windows.insert(2, key(10, "Draft", Some((800, 0))));
+        session.windows.insert(3, key(10, "Settings", None));
+        // Both live windows belong to process 10; their frames were swapped since.
+        let live = vec![
+            (WindowId(50), key(10, "Draft", Some((0, 0)))),
+            (WindowId(51), key(10, "Inbox", Some((800, 0)))),
+        ];
+
+        let matched = session.match_windows(&live);
+        // Titles outweigh frames, and each live window is used once.
+        assert_eq!(matched.get(&WindowId(1)), Some(&WindowId(51)));
+        assert_eq!(matched.get(&WindowId(2)), Some(&WindowId(50)));
+        assert_eq!(matched.get(&WindowId(3)), None);
+    }
+
+    #[test]
+    fn windows_of_other_processes_never_match() {
+        let mut session = Session::new();
+        session.windows.insert(1, key(10, "Inbox", Some((0, 0))));
+        session.windows.insert(2, key(11, "Inbox", Some((0, 0))));
+        let live = vec![(WindowId(50), key(11, "Inbox", Some((0, 0)))), (WindowId(51), key(12, "Inbox", None))];
+
+        let matched = session.match_windows(&live);
+        assert_eq!(matched.len(), 1);
+        assert_eq!(matched.get(&WindowId(2)), Some(&WindowId(50)));
+    }
+}
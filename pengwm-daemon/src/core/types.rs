@@ -2,9 +2,10 @@
 
 use serde::{Serialize, Deserialize};
 
-/// A unique identifier for a window.
+/// A unique identifier for a window, assigned by the backend: a generational handle on
+/// macOS, the window handle on Windows (only its low 32 bits are significant).
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Serialize, Deserialize)]
-pub struct WindowId(pub usize);
+pub struct WindowId(pub u32);
 
 /// A unique identifier for a monitor.
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Serialize, Deserialize)]
@@ -15,14 +16,23 @@ pub struct MonitorId(pub usize);
 pub enum SystemEvent {
     /// A new window has been created.
     WindowCreated(WindowId),
+    /// Windows that already existed when the backend started, reported together so they
+    /// are tiled in a single layout pass.
+    WindowsDiscovered(Vec<WindowId>),
     /// A window has been destroyed.
     WindowDestroyed(WindowId),
     /// A window has gained focus.
     WindowFocused(WindowId),
+    /// A window was moved or resized, possibly by something other than a layout pass.
+    WindowMoved(WindowId),
+    /// A window's title changed.
+    WindowTitleChanged(WindowId),
     /// A new monitor has been added.
     MonitorAdded(MonitorId),
     /// A monitor has been removed.
     MonitorRemoved(MonitorId),
+    /// A monitor's resolution or arrangement changed.
+    MonitorChanged(MonitorId),
     /// An application has been launched.
     AppLaunched(i32), // PID of the new application
 }
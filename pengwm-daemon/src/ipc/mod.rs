@@ -2,11 +2,36 @@
 //! Enables communication between the daemon and external UI clients (Tauri).
 
 use serde::{Serialize, Deserialize};
-use interprocess::local_socket::{LocalSocketListener, LocalSocketStream};
-use std::io::Write;
-use tokio::sync::broadcast;
-use tokio::task;
+use interprocess::local_socket::tokio::{LocalSocketListener, LocalSocketStream};
+use interprocess::local_socket::tokio::OwnedReadHalf;
+use futures::io::{AsyncBufReadExt, AsyncReadExt, AsyncWriteExt, BufReader};
+use tokio::sync::{broadcast, mpsc, oneshot};
+use tokio::sync::broadcast::error::RecvError;
+use tokio::sync::mpsc::error::TrySendError;
+use std::collections::{HashMap, HashSet};
 use std::sync::{Arc, Mutex};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::time::Duration;
+use crate::core::bsp::TreeStats;
+use crate::core::metrics::{metrics, MetricsSnapshot};
+use crate::core::queue::QueueStats;
+
+/// Maximum number of broadcast frames queued for one client before it is evicted as a slow
+/// consumer.
+const CLIENT_QUEUE_FRAMES: usize = 64;
+
+/// Number of requests from one client that may be in flight. Responses are queued apart from
+/// broadcasts, so a client pipelining requests is never evicted for it.
+const CLIENT_REPLY_FRAMES: usize = 256;
+
+/// How long a single write to a client may take before the client is evicted.
+const CLIENT_WRITE_TIMEOUT: Duration = Duration::from_secs(2);
+
+/// Number of client commands that may wait for the Window Manager before readers pause.
+const COMMAND_QUEUE: usize = 256;
+
+/// Largest MessagePack request accepted from a client, in bytes.
+const MAX_REQUEST_BYTES: usize = 1 << 20;
 
 /// Commands that external clients can send to the daemon.
 #[derive(Debug, Clone, Serialize, Deserialize)]
@@ -14,36 +39,179 @@ use std::sync::{Arc, Mutex};
 pub enum IpcCommand {
     /// Update the maximum tiles allowed per workspace.
     SetMaxTiles { workspace: u8, limit: usize },
-    /// Define a new hotkey action.
-    RegisterHotkey { keys: Vec<String>, action: String },
     /// Force a reload of the configuration file.
     ReloadConfig,
     /// Request the current state of the window tree.
     GetState,
+    /// Request the latency and queue depth histograms. Answered by the IPC server without
+    /// waiting for the Window Manager, so it also works while the manager is stalled.
+    GetMetrics,
+    /// Exchange the positions of two managed windows.
+    SwapWindows { a: u32, b: u32 },
+    /// Change the split ratio of the split containing `window`.
+    SetRatio { window: u32, ratio: f32 },
+    /// Show another workspace on the display holding the focused window.
+    SwitchWorkspace { workspace: u8 },
+    /// Move a window to another workspace of its display.
+    MoveToWorkspace { window: u32, workspace: u8 },
+    /// Rotate the windows of a tile; `window` defaults to the focused window.
+    CycleStack {
+        window: Option<u32>,
+        #[serde(default)]
+        reverse: bool,
+    },
+    /// Make a stacked window the visible one of its tile.
+    PromoteWindow { window: u32 },
+    /// Move a window to the back of its tile's stack; `window` defaults to the focused window.
+    SendToBack { window: Option<u32> },
+    /// Apply several commands to the tree followed by a single layout pass.
+    Batch { commands: Vec<IpcCommand> },
+}
+
+/// A command sent by a client, tagged with an ID that is echoed back in the response.
+/// Clients may send many requests without waiting for the responses in between.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct IpcRequest {
+    /// Chosen by the client. Requests that could not be parsed are answered with ID 0.
+    pub id: u64,
+    /// The command to execute.
+    #[serde(flatten)]
+    pub command: IpcCommand,
+}
+
+/// The outcome of a command.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+#[serde(tag = "status", content = "data")]
+pub enum IpcReply {
+    /// The command was applied.
+    Ok,
+    /// The current state, in reply to `GetState`.
+    State(UiState),
+    /// The histograms, in reply to `GetMetrics`.
+    Metrics(MetricsSnapshot),
+    /// The command was rejected or failed.
+    Error(String),
+}
+
+/// The response to one request, sent only to the client that made it.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct IpcResponse {
+    /// The ID of the request this answers.
+    pub id: u64,
+    /// The outcome of the request.
+    #[serde(flatten)]
+    pub reply: IpcReply,
+}
+
+/// A client command waiting to be executed by the Window Manager.
+#[derive(Debug)]
+pub struct PendingCommand {
+    /// The command to execute.
+    pub command: IpcCommand,
+    /// Where the outcome is sent once the command has been handled.
+    pub reply: oneshot::Sender<IpcReply>,
+}
+
+/// Creates the channel that carries client commands from the IPC server to the Window Manager.
+pub fn command_channel() -> (mpsc::Sender<PendingCommand>, mpsc::Receiver<PendingCommand>) {
+    mpsc::channel(COMMAND_QUEUE)
 }
 
 /// Events sent from the daemon to all connected UI clients.
+///
+/// Every event that changes the state carries a sequence number one higher than the
+/// previous one. A client that sees a gap has missed an update and should reconnect
+/// to receive a fresh snapshot.
 #[derive(Debug, Clone, Serialize, Deserialize)]
 #[serde(tag = "type", content = "data")]
 pub enum UiEvent {
-    /// Broadcasted when the window manager's layout or state changes.
+    /// The full state. Sent to each client when it connects.
     StateChanged(UiState),
+    /// The response to a client's request. Not part of the sequence of state updates.
+    Response(IpcResponse),
+    /// The windows that were added, changed or removed since the previous sequence number.
+    StateDelta(StateDelta),
+    /// Broadcasted when only the focused window changed.
+    FocusChanged {
+        /// Sequence number of this update.
+        seq: u64,
+        /// The ID of the newly focused window, if any.
+        focused_window: Option<u32>,
+    },
+}
+
+/// An incremental update relative to the state with sequence number `seq - 1`.
+#[derive(Debug, Clone, Serialize, Deserialize, Default)]
+pub struct StateDelta {
+    /// Sequence number of this update.
+    pub seq: u64,
+    /// Windows that were not part of the previous state.
+    pub added: Vec<WindowInfo>,
+    /// Windows whose geometry, title or stack changed.
+    pub moved: Vec<WindowInfo>,
+    /// IDs of windows that are no longer managed or visible.
+    pub removed: Vec<u32>,
+    /// The ID of the currently focused window, if any.
+    pub focused_window: Option<u32>,
+    /// Shape counters of the window tree.
+    pub stats: TreeStats,
+    /// Counters of the backend event queue.
+    pub queue: QueueStats,
+}
+
+impl StateDelta {
+    /// Computes the changes needed to turn `old` into `new`.
+    fn between(old: &UiState, new: &UiState, seq: u64) -> Self {
+        let previous: HashMap<u32, &WindowInfo> = old.windows.iter().map(|w| (w.id, w)).collect();
+        let mut delta = StateDelta {
+            seq,
+            focused_window: new.focused_window,
+            stats: new.stats,
+            queue: new.queue,
+            ..Default::default()
+        };
+        for window in &new.windows {
+            match previous.get(&window.id) {
+                None => delta.added.push(window.clone()),
+                Some(prev) if *prev != window => delta.moved.push(window.clone()),
+                Some(_) => {}
+            }
+        }
+        let current: HashSet<u32> = new.windows.iter().map(|w| w.id).collect();
+        delta.removed = old.windows.iter().map(|w| w.id).filter(|id| !current.contains(id)).collect();
+        delta
+    }
+
+    /// Returns `true` if the delta carries no change a client would render.
+    fn is_noop(&self, old: &UiState) -> bool {
+        self.added.is_empty()
+            && self.moved.is_empty()
+            && self.removed.is_empty()
+            && self.focused_window == old.focused_window
+            && self.stats == old.stats
+    }
 }
 
 /// Current state of the window manager, synchronized with the UI.
 #[derive(Debug, Clone, Serialize, Deserialize, Default)]
 pub struct UiState {
+    /// Sequence number of the last update folded into this state.
+    pub seq: u64,
     /// List of managed windows and their current geometries.
     pub windows: Vec<WindowInfo>,
     /// The ID of the currently focused window, if any.
-    pub focused_window: Option<usize>,
+    pub focused_window: Option<u32>,
+    /// Shape counters of the window tree (tiles, stacked windows, depth).
+    pub stats: TreeStats,
+    /// Counters of the backend event queue, to spot when the event path saturates.
+    pub queue: QueueStats,
 }
 
 /// Metadata about a single managed window.
-#[derive(Debug, Clone, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct WindowInfo {
-    /// Unique identifier for the window (pointer address).
-    pub id: usize,
+    /// Unique identifier for the window.
+    pub id: u32,
     /// The display title of the window.
     pub title: String,
     /// X coordinate of the window's top-left corner.
@@ -54,80 +222,392 @@ pub struct WindowInfo {
     pub width: u32,
     /// Height of the window in pixels.
     pub height: u32,
+    /// Number of windows stacked behind this one in its tile.
+    pub stacked: usize,
+    /// The display the window is tiled on.
+    pub monitor: usize,
+    /// The workspace of that display the window belongs to.
+    pub workspace: usize,
+}
+
+/// Wire formats a client can choose by connecting to the matching endpoint.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Encoding {
+    /// Newline-delimited JSON, used by the Tauri UI and scripts.
+    Json,
+    /// Length-prefixed MessagePack (a big-endian `u32` byte count, then the body),
+    /// for native clients that want smaller payloads and cheaper decoding.
+    MessagePack,
+}
+
+impl Encoding {
+    /// The local socket / named pipe clients connect to for this encoding.
+    pub fn endpoint(self) -> &'static str {
+        match self {
+            #[cfg(target_os = "windows")]
+            Encoding::Json => "\\\\.\\pipe\\pengwm-ipc",
+            #[cfg(target_os = "windows")]
+            Encoding::MessagePack => "\\\\.\\pipe\\pengwm-ipc-msgpack",
+            #[cfg(target_os = "macos")]
+            Encoding::Json => "/tmp/pengwm.sock",
+            #[cfg(target_os = "macos")]
+            Encoding::MessagePack => "/tmp/pengwm-msgpack.sock",
+        }
+    }
+
+    /// Encodes a value as one complete frame in this format.
+    pub fn encode<T: Serialize>(self, value: &T) -> anyhow::Result<Vec<u8>> {
+        match self {
+            Encoding::Json => {
+                let mut buf = serde_json::to_vec(value)?;
+                buf.push(b'\n');
+                Ok(buf)
+            }
+            Encoding::MessagePack => {
+                let body = rmp_serde::to_vec_named(value)?;
+                let mut buf = Vec::with_capacity(body.len() + 4);
+                buf.extend_from_slice(&(body.len() as u32).to_be_bytes());
+                buf.extend_from_slice(&body);
+                Ok(buf)
+            }
+        }
+    }
+
+    /// Reads one request frame in this format. Returns `Ok(None)` once the client has
+    /// disconnected; the outer error means the stream can no longer be framed, the inner
+    /// one that a complete frame did not hold a valid request.
+    async fn read_request<R: futures::io::AsyncBufRead + Unpin>(
+        self,
+        reader: &mut R,
+    ) -> anyhow::Result<Option<anyhow::Result<IpcRequest>>> {
+        match self {
+            Encoding::Json => {
+                let mut line = String::new();
+                loop {
+                    line.clear();
+                    if reader.read_line(&mut line).await? == 0 {
+                        return Ok(None);
+                    }
+                    // Tolerate blank lines between requests.
+                    if !line.trim().is_empty() {
+                        return Ok(Some(serde_json::from_str(&line).map_err(Into::into)));
+                    }
+                }
+            }
+            Encoding::MessagePack => {
+                let mut len = [0u8; 4];
+                match reader.read_exact(&mut len).await {
+                    Ok(()) => {}
+                    Err(e) if e.kind() == std::io::ErrorKind::UnexpectedEof => return Ok(None),
+                    Err(e) => return Err(e.into()),
+                }
+                let len = u32::from_be_bytes(len) as usize;
+                anyhow::ensure!(len <= MAX_REQUEST_BYTES, "request of {} bytes exceeds the limit", len);
+                let mut body = vec![0u8; len];
+                reader.read_exact(&mut body).await?;
+                Ok(Some(rmp_serde::from_slice(&body).map_err(Into::into)))
+            }
+        }
+    }
+}
+
+/// A UI event serialized once per wire format and shared by every subscriber.
+#[derive(Debug, Clone)]
+struct EncodedEvent {
+    /// The JSON frame, always present.
+    json: Arc<[u8]>,
+    /// The MessagePack frame, only produced while a MessagePack client is connected.
+    msgpack: Option<Arc<[u8]>>,
+}
+
+impl EncodedEvent {
+    /// Returns the frame for the given encoding, if it was produced.
+    fn frame(&self, encoding: Encoding) -> Option<&Arc<[u8]>> {
+        match encoding {
+            Encoding::Json => Some(&self.json),
+            Encoding::MessagePack => self.msgpack.as_ref(),
+        }
+    }
 }
 
 /// The IPC server that handles multiple client connections and broadcasts updates.
 pub struct IpcServer {
-    /// Channel used for broadcasting UI events to all connected streams.
-    tx: broadcast::Sender<UiEvent>,
+    /// Channel used for broadcasting pre-encoded UI events to all connected streams.
+    tx: broadcast::Sender<EncodedEvent>,
     /// Cached latest state for new connections.
     state: Arc<Mutex<UiState>>,
+    /// Number of connected MessagePack clients; the binary frame is skipped while it is zero.
+    msgpack_clients: AtomicUsize,
+    /// Forwards client commands to the Window Manager.
+    commands: mpsc::Sender<PendingCommand>,
 }
 
 impl IpcServer {
-    /// Initializes a new IPC server.
-    pub fn new() -> Self {
+    /// Initializes a new IPC server that forwards client commands to `commands`.
+    pub fn new(commands: mpsc::Sender<PendingCommand>) -> Self {
         let (tx, _) = broadcast::channel(16);
         Self {
             tx,
             state: Arc::new(Mutex::new(UiState::default())),
+            msgpack_clients: AtomicUsize::new(0),
+            commands,
+        }
+    }
+
+    /// Returns the most recently broadcast state.
+    pub fn current_state(&self) -> UiState {
+        self.state.lock().unwrap().clone()
+    }
+
+    /// Broadcasts the changes between the cached state and `new_state` to all connected UI clients.
+    /// The new state replaces the cached one, which is what new connections receive.
+    pub fn broadcast_state(&self, mut new_state: UiState) {
+        let mut state = self.state.lock().unwrap();
+        let delta = StateDelta::between(&state, &new_state, state.seq + 1);
+        if delta.is_noop(&state) {
+            return;
         }
+        new_state.seq = delta.seq;
+        *state = new_state;
+        // Send only the delta across the broadcast channel.
+        self.publish(&UiEvent::StateDelta(delta));
     }
 
-    /// Broadcasts a new state to all connected UI clients.
-    pub fn broadcast_state(&self, new_state: UiState) {
+    /// Broadcasts a focus change without resending the window list.
+    pub fn broadcast_focus(&self, focused_window: Option<u32>) {
         let mut state = self.state.lock().unwrap();
-        *state = new_state.clone();
-        // Send the state update across the broadcast channel.
-        let _ = self.tx.send(UiEvent::StateChanged(new_state));
+        if state.focused_window == focused_window {
+            return;
+        }
+        state.focused_window = focused_window;
+        state.seq += 1;
+        self.publish(&UiEvent::FocusChanged { seq: state.seq, focused_window });
+    }
+
+    /// Serializes an event once per active encoding and hands the buffers to every subscriber.
+    /// Must be called with the state lock held so events keep their sequence order.
+    fn publish(&self, event: &UiEvent) {
+        let json = match Encoding::Json.encode(event) {
+            Ok(buf) => Arc::from(buf),
+            Err(e) => {
+                log::error!("Failed to encode UI event: {}", e);
+                return;
+            }
+        };
+        let msgpack = if self.msgpack_clients.load(Ordering::Relaxed) > 0 {
+            Encoding::MessagePack.encode(event).ok().map(Arc::from)
+        } else {
+            None
+        };
+        let _ = self.tx.send(EncodedEvent { json, msgpack });
+    }
+
+    /// Subscribes to updates and returns the snapshot they apply on top of.
+    /// Both happen under the state lock, so no update can fall between them.
+    fn subscribe(&self, encoding: Encoding) -> (UiState, broadcast::Receiver<EncodedEvent>) {
+        let state = self.state.lock().unwrap();
+        if encoding == Encoding::MessagePack {
+            self.msgpack_clients.fetch_add(1, Ordering::Relaxed);
+        }
+        (state.clone(), self.tx.subscribe())
+    }
+
+    /// Forgets a client that disconnected.
+    fn unsubscribe(&self, encoding: Encoding) {
+        if encoding == Encoding::MessagePack {
+            self.msgpack_clients.fetch_sub(1, Ordering::Relaxed);
+        }
     }
 }
 
 /// Starts the IPC server and listens for incoming local socket connections.
+/// Each encoding has its own endpoint; connecting to one selects the wire format.
 pub async fn start_ipc_server(server: Arc<IpcServer>) -> anyhow::Result<()> {
-    #[cfg(target_os = "windows")]
-    let pipe_name = "\\\\.\\pipe\\pengwm-ipc";
-    #[cfg(target_os = "macos")]
-    let pipe_name = "/tmp/pengwm.sock";
-
-    // Clean up existing socket file on Unix-like systems.
-    #[cfg(target_os = "macos")]
-    let _ = std::fs::remove_file(pipe_name);
-
-    let listener = LocalSocketListener::bind(pipe_name)?;
-    log::info!("IPC server listening on {}", pipe_name);
-
-    let server_clone = server.clone();
-    // Spawn a blocking task to accept new connections.
-    task::spawn_blocking(move || {
-        for conn in listener.incoming() {
-            match conn {
-                Ok(stream) => {
-                    log::info!("New IPC connection established");
-                    let server_inner = server_clone.clone();
-                    // Handle each connection in its own asynchronous task.
-                    task::spawn(handle_connection(stream, server_inner));
+    for encoding in [Encoding::Json, Encoding::MessagePack] {
+        let pipe_name = encoding.endpoint();
+
+        // Clean up existing socket file on Unix-like systems.
+        #[cfg(target_os = "macos")]
+        let _ = std::fs::remove_file(pipe_name);
+
+        let listener = LocalSocketListener::bind(pipe_name)?;
+        log::info!("IPC server listening on {} ({:?})", pipe_name, encoding);
+
+        let server_clone = server.clone();
+        // Accept new connections without tying up a runtime thread.
+        tokio::spawn(async move {
+            loop {
+                match listener.accept().await {
+                    Ok(stream) => {
+                        log::info!("New IPC connection established");
+                        // Handle each connection in its own asynchronous task.
+                        tokio::spawn(handle_connection(stream, server_clone.clone(), encoding));
+                    }
+                    Err(e) => log::error!("IPC connection failed: {}", e),
                 }
-                Err(e) => log::error!("IPC connection failed: {}", e),
             }
-        }
-    });
+        });
+    }
 
     Ok(())
 }
 
-/// Manages a single client connection, streaming broadcasted events.
-async fn handle_connection(mut stream: LocalSocketStream, server: Arc<IpcServer>) {
-    let mut rx = server.tx.subscribe();
-    
-    tokio::spawn(async move {
-        // Send updates as JSON-encoded lines to the client.
-        while let Ok(event) = rx.recv().await {
-            let json = serde_json::to_string(&event).unwrap() + "\n";
-            if let Err(e) = stream.write_all(json.as_bytes()) {
+/// Manages a single client connection, sending a snapshot followed by broadcasted deltas,
+/// while a separate task reads and dispatches the client's requests.
+///
+/// Broadcast frames for the client go through a bounded queue drained by a dedicated writer
+/// task. A client that lets the queue fill up, or takes longer than `CLIENT_WRITE_TIMEOUT`
+/// to accept a write, is disconnected so it cannot hold back the daemon or other clients.
+/// Responses have a queue of their own, which only throttles reading requests.
+async fn handle_connection(stream: LocalSocketStream, server: Arc<IpcServer>, encoding: Encoding) {
+    let (read_half, write_half) = stream.into_split();
+    let (out_tx, out_rx) = mpsc::channel(CLIENT_QUEUE_FRAMES);
+    let (reply_tx, reply_rx) = mpsc::channel(CLIENT_REPLY_FRAMES);
+    let writer = tokio::spawn(write_frames(write_half, out_rx, reply_rx));
+    let reader = tokio::spawn(read_requests(read_half, server.clone(), reply_tx, encoding));
+
+    let (snapshot, mut rx) = server.subscribe(encoding);
+    let mut connected = queue_snapshot(&out_tx, snapshot, encoding);
+
+    while connected {
+        tokio::select! {
+            result = rx.recv() => match result {
+                Ok(event) => {
+                    let Some(frame) = event.frame(encoding) else {
+                        continue;
+                    };
+                    match out_tx.try_send(frame.clone()) {
+                        Ok(()) => {}
+                        Err(TrySendError::Full(_)) => {
+                            log::warn!("Evicting slow IPC client ({} frames queued)", CLIENT_QUEUE_FRAMES);
+                            connected = false;
+                        }
+                        Err(TrySendError::Closed(_)) => connected = false,
+                    }
+                }
+                Err(RecvError::Lagged(skipped)) => {
+                    // Deltas were lost; start the client over from a fresh snapshot.
+                    log::warn!("IPC client lagged by {} event(s); resyncing", skipped);
+                    server.unsubscribe(encoding);
+                    let (snapshot, new_rx) = server.subscribe(encoding);
+                    rx = new_rx;
+                    connected = queue_snapshot(&out_tx, snapshot, encoding);
+                }
+                Err(RecvError::Closed) => connected = false,
+            },
+            // The writer stopped because the client went away or was too slow.
+            _ = out_tx.closed() => connected = false,
+        }
+    }
+
+    server.unsubscribe(encoding);
+    reader.abort();
+    drop(out_tx);
+    let _ = writer.await;
+    log::info!("IPC connection closed");
+}
+
+/// Encodes a full snapshot and queues it for the client. Returns `false` if the client is gone.
+fn queue_snapshot(out_tx: &mpsc::Sender<Arc<[u8]>>, snapshot: UiState, encoding: Encoding) -> bool {
+    match encoding.encode(&UiEvent::StateChanged(snapshot)) {
+        Ok(frame) => out_tx.try_send(Arc::from(frame)).is_ok(),
+        Err(e) => {
+            log::error!("Failed to encode snapshot: {}", e);
+            false
+        }
+    }
+}
+
+/// Reads requests until the client disconnects and forwards each to the Window Manager.
+///
+/// Requests are dispatched as soon as they are read; each response is queued for the
+/// client when its command completes. A slot in the response queue is reserved before a
+/// request is dispatched, so a client that stops reading responses also stops having
+/// requests read.
+async fn read_requests(
+    stream: OwnedReadHalf,
+    server: Arc<IpcServer>,
+    reply_tx: mpsc::Sender<Arc<[u8]>>,
+    encoding: Encoding,
+) {
+    let mut reader = BufReader::new(stream);
+    loop {
+        let request = match encoding.read_request(&mut reader).await {
+            Ok(Some(request)) => request,
+            Ok(None) => break,
+            Err(e) => {
+                log::warn!("Closing IPC connection after unreadable request: {}", e);
+                break;
+            }
+        };
+        let Ok(permit) = reply_tx.clone().reserve_owned().await else {
+            break;
+        };
+
+        let IpcRequest { id, command } = match request {
+            Ok(request) => request,
+            Err(e) => {
+                log::warn!("Rejecting malformed IPC request: {}", e);
+                permit.send(encode_response(encoding, 0, IpcReply::Error(e.to_string())));
+                continue;
+            }
+        };
+        if let IpcCommand::GetMetrics = command {
+            permit.send(encode_response(encoding, id, IpcReply::Metrics(metrics().snapshot())));
+            continue;
+        }
+        let (reply, reply_rx) = oneshot::channel();
+        if server.commands.send(PendingCommand { command, reply }).await.is_err() {
+            break;
+        }
+
+        // Keep reading while the command runs so later requests are pipelined behind it.
+        tokio::spawn(async move {
+            let reply = reply_rx.await.unwrap_or_else(|_| IpcReply::Error("command was dropped".into()));
+            permit.send(encode_response(encoding, id, reply));
+        });
+    }
+}
+
+/// Encodes the response to request `id`.
+fn encode_response(encoding: Encoding, id: u64, reply: IpcReply) -> Arc<[u8]> {
+    let event = UiEvent::Response(IpcResponse { id, reply });
+    match encoding.encode(&event) {
+        Ok(frame) => Arc::from(frame),
+        Err(e) => {
+            log::error!("Failed to encode IPC response: {}", e);
+            let fallback = UiEvent::Response(IpcResponse { id, reply: IpcReply::Error(e.to_string()) });
+            Arc::from(encoding.encode(&fallback).unwrap_or_default())
+        }
+    }
+}
+
+/// Writes queued broadcasts and responses to the client until the broadcast queue closes or
+/// a write fails or times out.
+async fn write_frames<W: futures::io::AsyncWrite + Unpin>(
+    mut stream: W,
+    mut out_rx: mpsc::Receiver<Arc<[u8]>>,
+    mut reply_rx: mpsc::Receiver<Arc<[u8]>>,
+) {
+    loop {
+        // Once the reader is gone and its responses are written, only broadcasts remain.
+        let frame = tokio::select! {
+            frame = out_rx.recv() => match frame {
+                Some(frame) => frame,
+                None => break,
+            },
+            Some(frame) = reply_rx.recv() => frame,
+        };
+        match tokio::time::timeout(CLIENT_WRITE_TIMEOUT, stream.write_all(&frame)).await {
+            Ok(Ok(())) => {}
+            Ok(Err(e)) => {
                 log::error!("Failed to send broadcast to UI: {}", e);
                 break;
             }
+            Err(_) => {
+                log::warn!("Evicting IPC client that stopped reading");
+                break;
+            }
         }
-    });
+    }
 }
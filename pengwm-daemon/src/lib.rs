@@ -0,0 +1,11 @@
+//! The pengwm window manager as a library.
+//! Shared by the daemon and by tools such as the `replay` harness.
+
+/// Core window management logic and types.
+pub mod core;
+/// Platform-specific windowing system integrations.
+pub mod platform;
+/// Inter-process communication for the UI.
+pub mod ipc;
+/// Configuration management and file watching.
+pub mod config;
@@ -1,22 +1,17 @@
 //! Main entry point for the pengwm-daemon.
 //! Initializes the window manager backend, configuration, and IPC server.
 
-/// Core window management logic and types.
-mod core;
-/// Platform-specific windowing system integrations.
-mod platform;
-/// Inter-process communication for the UI.
-mod ipc;
-/// Configuration management and file watching.
-mod config;
-
-use crate::platform::WindowManagerBackend;
-use crate::platform::macos::MacOsBackend;
-use crate::core::manager::WindowManager;
-use crate::config::Config;
-use crate::ipc::IpcServer;
+use pengwm_daemon::platform::WindowManagerBackend;
+use pengwm_daemon::platform::macos::MacOsBackend;
+use pengwm_daemon::core::manager::WindowManager;
+use pengwm_daemon::core::recording::Recorder;
+use pengwm_daemon::core::session;
+use pengwm_daemon::config::Config;
+use pengwm_daemon::config::rules::RuleSet;
+use pengwm_daemon::config::watcher::ConfigWatcher;
+use pengwm_daemon::ipc::{self, IpcServer};
+use pengwm_daemon::core::queue;
 use std::sync::Arc;
-use tokio::sync::mpsc;
 
 #[tokio::main]
 async fn main() -> anyhow::Result<()> {
@@ -26,28 +21,53 @@ async fn main() -> anyhow::Result<()> {
 
     // Select the appropriate window manager backend based on the target OS.
     #[cfg(target_os = "windows")]
-    let backend = Arc::new(crate::platform::windows::WindowsBackend);
+    let backend = Arc::new(pengwm_daemon::platform::windows::WindowsBackend::new());
     
     #[cfg(target_os = "macos")]
-    let backend = Arc::new(MacOsBackend);
+    let backend = Arc::new(MacOsBackend::new());
 
     // Load user configuration from config.toml or use defaults.
     let config = Config::load();
+
+    // Compiled once; installed before discovery so windows found at startup are covered.
+    backend.set_rules(Arc::new(RuleSet::compile(&config.rules)));
     
-    // Communication channel between the OS backend and the Window Manager.
-    let (event_tx, event_rx) = mpsc::channel(100);
+    // Unbounded, metered queue between the OS backend and the Window Manager.
+    let (mut event_tx, event_rx) = queue::event_queue();
+
+    // With PENGWM_RECORD set, every event is also written to that file for `replay`.
+    if let Some(path) = std::env::var_os("PENGWM_RECORD") {
+        match Recorder::create(&path, &backend.monitors()) {
+            Ok(recorder) => {
+                log::info!("Recording events to {:?}", path);
+                event_tx = event_tx.recorded(recorder);
+            }
+            Err(e) => log::error!("Cannot record events to {:?}: {}", path, e),
+        }
+    }
 
-    // The IPC server allows the Tauri UI to receive updates.
-    let ipc_server = Arc::new(IpcServer::new());
+    // The IPC server allows the Tauri UI to receive updates and clients to send commands.
+    let (command_tx, command_rx) = ipc::command_channel();
+    let ipc_server = Arc::new(IpcServer::new(command_tx.clone()));
+
+    // Edits to config.toml are applied without a restart, through the same command queue.
+    let _config_watcher = match ConfigWatcher::spawn(command_tx) {
+        Ok(watcher) => Some(watcher),
+        Err(e) => {
+            log::warn!("Config file watching unavailable: {}", e);
+            None
+        }
+    };
 
     // Subscribe to system events (window creation, destruction, etc.).
     let backend_clone = backend.clone();
     backend_clone.subscribe(event_tx).await;
 
-    // Initialize and start the core Window Manager loop.
-    let mut wm = WindowManager::new(backend, config, ipc_server.clone());
+    // Initialize and start the core Window Manager loop. The trees of the previous run are
+    // restored from the session file once discovery reports the windows that are still open.
+    let mut wm = WindowManager::new(backend, config, ipc_server.clone()).with_session(session::default_path());
     tokio::spawn(async move {
-        wm.run(event_rx).await;
+        wm.run(event_rx, command_rx).await;
     });
 
     // Start the IPC server to communicate with the UI.
@@ -61,6 +81,17 @@ async fn main() -> anyhow::Result<()> {
     log::info!("Daemon running. Press Ctrl+C to exit.");
     
     // Block the main thread until a termination signal is received.
+    #[cfg(target_os = "macos")]
+    {
+        // AppKit delivers NSWorkspace notifications through the main thread's run loop, so the
+        // main thread runs it; every task keeps running on the runtime's worker threads.
+        tokio::spawn(async {
+            let _ = tokio::signal::ctrl_c().await;
+            MacOsBackend::stop_main_loop();
+        });
+        MacOsBackend::run_main_loop();
+    }
+    #[cfg(not(target_os = "macos"))]
     tokio::signal::ctrl_c().await?;
     log::info!("Shutting down...");
 
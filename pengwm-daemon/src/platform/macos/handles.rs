@@ -0,0 +1,189 @@
+//! Registry of the window elements the backend holds on to.
+//!
+//! Accessibility hands out a new `AXUIElementRef` every time a window is reported, so the
+//! same window can arrive as different pointers, and a freed pointer can be reused for
+//! another element. Elements are interned by `CFEqual`/`CFHash` into compact generational
+//! ids, each retained exactly once until the id is released. An id whose slot has been
+//! reused no longer resolves. Elements handed out are retained again for as long as the
+//! caller uses them, so releasing an id never frees an element in use on another thread.
+
+use crate::core::types::WindowId;
+use accessibility_sys::AXUIElementRef;
+use core_foundation::base::{CFEqual, CFHash, CFRelease, CFRetain};
+use std::collections::HashMap;
+use std::hash::{Hash, Hasher};
+use std::sync::{Mutex, OnceLock};
+
+/// Bits of an id holding the slot index; the rest hold the slot's generation.
+const INDEX_BITS: u32 = 20;
+/// Mask selecting the slot index of an id.
+const INDEX_MASK: u32 = (1 << INDEX_BITS) - 1;
+/// Number of distinct generations before a slot's ids repeat.
+const GENERATIONS: u32 = 1 << (32 - INDEX_BITS);
+
+/// An element used as a map key, compared the way CoreFoundation compares elements.
+struct ElementKey(AXUIElementRef);
+
+impl PartialEq for ElementKey {
+    fn eq(&self, other: &Self) -> bool {
+        unsafe { CFEqual(self.0 as _, other.0 as _) != 0 }
+    }
+}
+
+impl Eq for ElementKey {}
+
+impl Hash for ElementKey {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        unsafe { CFHash(self.0 as _) }.hash(state);
+    }
+}
+
+/// An element resolved from an id, retained until dropped.
+pub(super) struct Element(AXUIElementRef);
+
+impl Element {
+    /// Returns the element, valid while `self` is alive.
+    pub(super) fn as_ptr(&self) -> AXUIElementRef {
+        self.0
+    }
+}
+
+impl Drop for Element {
+    fn drop(&mut self) {
+        unsafe { CFRelease(self.0 as _) };
+    }
+}
+
+/// One registry entry.
+struct Slot {
+    /// The retained element, or null while the slot is free.
+    element: AXUIElementRef,
+    /// The owning process, read once when the element was interned.
+    pid: i32,
+    /// Incremented whenever the slot is freed, so earlier ids stop resolving. Never 0.
+    generation: u32,
+}
+
+/// The registry state, guarded by one lock.
+#[derive(Default)]
+struct Table {
+    /// Entries by slot index.
+    slots: Vec<Slot>,
+    /// Indices of free slots, reused before the table grows.
+    free: Vec<u32>,
+    /// Index of the slot holding each interned element.
+    by_element: HashMap<ElementKey, u32>,
+}
+
+/// Interned window elements. Shared by the backend and its callbacks; see `handles()`.
+#[derive(Default)]
+pub(super) struct HandleRegistry {
+    table: Mutex<Table>,
+}
+
+// Elements are only retained, released and compared, which CoreFoundation allows from any
+// thread; the table itself is only touched under its lock.
+unsafe impl Send for HandleRegistry {}
+unsafe impl Sync for HandleRegistry {}
+
+/// Returns the process-wide registry.
+pub(super) fn handles() -> &'static HandleRegistry {
+    static HANDLES: OnceLock<HandleRegistry> = OnceLock::new();
+    HANDLES.get_or_init(HandleRegistry::default)
+}
+
+impl HandleRegistry {
+    /// Returns the id of `element`, interning and retaining it if it is new.
+    /// The flag is `true` only for a newly interned element, which the caller should report;
+    /// an element seen before keeps its id and is not retained again.
+    pub(super) fn intern(&self, element: AXUIElementRef) -> Option<(WindowId, bool)> {
+        if element.is_null() {
+            return None;
+        }
+        let mut table = self.table.lock().unwrap();
+        if let Some(&index) = table.by_element.get(&ElementKey(element)) {
+            return Some((id(index, table.slots[index as usize].generation), false));
+        }
+        let mut pid = 0;
+        if unsafe { accessibility_sys::AXUIElementGetPid(element, &mut pid) } != 0 {
+            return None;
+        }
+
+        unsafe { CFRetain(element as _) };
+        let index = match table.free.pop() {
+            Some(index) => {
+                let slot = &mut table.slots[index as usize];
+                slot.element = element;
+                slot.pid = pid;
+                index
+            }
+            None => {
+                let index = table.slots.len() as u32;
+                if index > INDEX_MASK {
+                    unsafe { CFRelease(element as _) };
+                    log::error!("Window handle registry is full");
+                    return None;
+                }
+                table.slots.push(Slot { element, pid, generation: 1 });
+                index
+            }
+        };
+        table.by_element.insert(ElementKey(element), index);
+        Some((id(index, table.slots[index as usize].generation), true))
+    }
+
+    /// Returns the id of an already interned element, without retaining it.
+    pub(super) fn lookup(&self, element: AXUIElementRef) -> Option<WindowId> {
+        if element.is_null() {
+            return None;
+        }
+        let table = self.table.lock().unwrap();
+        let &index = table.by_element.get(&ElementKey(element))?;
+        Some(id(index, table.slots[index as usize].generation))
+    }
+
+    /// Returns the element behind an id, or `None` if it has been released. It is retained
+    /// under the lock, so a concurrent `release` cannot free it while it is used.
+    pub(super) fn element(&self, window: WindowId) -> Option<Element> {
+        let table = self.table.lock().unwrap();
+        table.slot(window).map(|slot| {
+            unsafe { CFRetain(slot.element as _) };
+            Element(slot.element)
+        })
+    }
+
+    /// Returns the process owning a window, without messaging it.
+    pub(super) fn pid(&self, window: WindowId) -> Option<i32> {
+        let table = self.table.lock().unwrap();
+        table.slot(window).map(|slot| slot.pid)
+    }
+
+    /// Drops the registry's reference to a window. Its id stops resolving.
+    pub(super) fn release(&self, window: WindowId) {
+        let mut table = self.table.lock().unwrap();
+        let Some(element) = table.slot(window).map(|slot| slot.element) else {
+            return;
+        };
+        let index = window.0 & INDEX_MASK;
+        table.by_element.remove(&ElementKey(element));
+        let slot = &mut table.slots[index as usize];
+        slot.element = std::ptr::null_mut();
+        slot.generation = slot.generation % (GENERATIONS - 1) + 1;
+        table.free.push(index);
+        drop(table);
+        unsafe { CFRelease(element as _) };
+    }
+}
+
+impl Table {
+    /// Looks up the live slot an id refers to.
+    fn slot(&self, window: WindowId) -> Option<&Slot> {
+        let slot = self.slots.get((window.0 & INDEX_MASK) as usize)?;
+        (!slot.element.is_null() && slot.generation == window.0 >> INDEX_BITS).then_some(slot)
+    }
+}
+
+/// Packs a slot index and generation into an id.
+fn id(index: u32, generation: u32) -> WindowId {
+    WindowId(generation << INDEX_BITS | index)
+}
@@ -1,44 +1,361 @@
 //! macOS implementation of the WindowManagerBackend trait.
 //! Uses Accessibility APIs (AXUIElement) to observe and control windows.
 
+mod handles;
+
 use async_trait::async_trait;
-use crate::platform::WindowManagerBackend;
-use crate::core::geometry::Rect;
-use crate::core::types::{WindowId, SystemEvent};
-use tokio::sync::mpsc::Sender;
+use crate::platform::{WindowManagerBackend, FrameChange};
+use crate::core::geometry::{Point, Rect, Size};
+use crate::core::types::{MonitorId, WindowId, SystemEvent};
+use crate::core::queue::EventSender;
+use crate::core::metrics::metrics;
+use crate::config::rules::{RuleAction, RuleSet, RuleSubject};
 use anyhow::Result;
-use core_foundation::runloop::{CFRunLoop, kCFRunLoopDefaultMode, CFRunLoopSource};
+use handles::handles;
+use core_foundation::runloop::{CFRunLoop, kCFRunLoopDefaultMode, kCFRunLoopRunFinished, CFRunLoopSource};
 use core_foundation::string::CFString;
 use core_foundation::base::{TCFType, CFRelease};
 use core_foundation::dictionary::CFDictionary;
 use core_foundation::boolean::CFBoolean;
+use std::collections::{HashMap, HashSet};
 use std::os::raw::c_void;
-use std::ptr;
+use std::ptr::{self, NonNull};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex, OnceLock, RwLock};
+use std::sync::mpsc as std_mpsc;
 use std::thread;
+use std::time::Duration;
+
+use block2::RcBlock;
 
 use accessibility_sys::{
-    AXUIElementRef, AXObserverRef, AXIsProcessTrusted, AXIsProcessTrustedWithOptions,
+    AXUIElementRef, AXObserverRef, AXError, AXIsProcessTrusted, AXIsProcessTrustedWithOptions,
+    kAXErrorCannotComplete,
 };
 
-use objc2_app_kit::{NSWorkspace, NSApplicationActivationPolicy};
+use objc2::MainThreadMarker;
+use objc2_app_kit::{
+    NSWorkspace, NSRunningApplication, NSApplicationActivationPolicy, NSWorkspaceApplicationKey,
+    NSWorkspaceDidLaunchApplicationNotification, NSWorkspaceDidTerminateApplicationNotification,
+    NSScreen,
+};
+use objc2_foundation::{NSNotification, NSOperationQueue, NSRect};
 
 /// macOS specific window manager backend.
-pub struct MacOsBackend;
+pub struct MacOsBackend {
+    /// Window attributes read once from the Accessibility API, shared with the observer thread.
+    metadata: Arc<MetadataCache>,
+    /// The observer of every application we watch, shared with the observer thread.
+    apps: Arc<AppTable>,
+}
+
+/// Set when the daemon shuts down, ending `MacOsBackend::run_main_loop`.
+static MAIN_LOOP_STOPPED: AtomicBool = AtomicBool::new(false);
+
+/// Longest the main run loop runs before checking whether it should stop.
+const MAIN_LOOP_SLICE: Duration = Duration::from_millis(500);
+
+/// Maximum number of applications whose windows are moved concurrently.
+const FRAME_WORKERS: usize = 4;
+
+/// How long a single Accessibility call may block on an unresponsive application.
+const AX_MESSAGING_TIMEOUT_SECS: f32 = 0.25;
+
+/// Maximum number of applications whose windows are enumerated concurrently at startup.
+const DISCOVERY_WORKERS: usize = 8;
+
+/// How long listing an application's windows may block at startup. Longer than
+/// `AX_MESSAGING_TIMEOUT_SECS`, since busy applications are common right after login.
+const DISCOVERY_TIMEOUT_SECS: f32 = 1.0;
+
+/// Delays before listing the windows of an application that timed out is tried again.
+const DISCOVERY_RETRIES: [Duration; 4] =
+    [Duration::from_secs(1), Duration::from_secs(2), Duration::from_secs(4), Duration::from_secs(8)];
+
+/// Upper bound on the number of displays queried from CoreGraphics.
+const MAX_DISPLAYS: usize = 16;
+
+/// Longest wait for the main thread to report the screens' visible frames.
+const MAIN_THREAD_TIMEOUT: Duration = Duration::from_secs(1);
+
+/// Display reconfiguration flag sent before a change is applied.
+const DISPLAY_BEGIN_CONFIGURATION_FLAG: u32 = 1 << 0;
+/// Display reconfiguration flag for a newly connected display.
+const DISPLAY_ADD_FLAG: u32 = 1 << 4;
+/// Display reconfiguration flag for a disconnected display.
+const DISPLAY_REMOVE_FLAG: u32 = 1 << 5;
 
 /// Represents a 2D point for CoreGraphics compatibility.
 #[repr(C)]
+#[derive(Default)]
 struct CGPoint { x: f64, y: f64 }
 
 /// Represents a 2D size for CoreGraphics compatibility.
 #[repr(C)]
+#[derive(Default)]
 struct CGSize { width: f64, height: f64 }
 
-/// A wrapper for the event sender to allow passing it across thread boundaries.
-struct RawSender(*mut Sender<SystemEvent>);
-unsafe impl Send for RawSender {}
-unsafe impl Sync for RawSender {}
+/// Represents a rectangle for CoreGraphics compatibility.
+#[repr(C)]
+struct CGRect { origin: CGPoint, size: CGSize }
+
+#[link(name = "CoreGraphics", kind = "framework")]
+extern "C" {
+    fn CGGetActiveDisplayList(max_displays: u32, active_displays: *mut u32, display_count: *mut u32) -> i32;
+    fn CGMainDisplayID() -> u32;
+    fn CGDisplayBounds(display: u32) -> CGRect;
+    fn CGDisplayRegisterReconfigurationCallback(
+        callback: unsafe extern "C" fn(u32, u32, *mut c_void),
+        user_info: *mut c_void,
+    ) -> i32;
+}
+
+/// Accessibility attribute, action and notification names, created once and reused.
+/// Each field holds the `AX…` string of the same name.
+struct AxKeys {
+    role: CFString,
+    subrole: CFString,
+    title: CFString,
+    position: CFString,
+    size: CFString,
+    windows: CFString,
+    raise: CFString,
+    window_created: CFString,
+    element_destroyed: CFString,
+    focused_window_changed: CFString,
+    title_changed: CFString,
+}
+
+// The strings are immutable after creation, which CoreFoundation allows sharing across threads.
+unsafe impl Send for AxKeys {}
+unsafe impl Sync for AxKeys {}
+
+/// Returns the interned Accessibility keys.
+fn keys() -> &'static AxKeys {
+    static KEYS: OnceLock<AxKeys> = OnceLock::new();
+    KEYS.get_or_init(|| AxKeys {
+        role: CFString::from_static_string("AXRole"),
+        subrole: CFString::from_static_string("AXSubrole"),
+        title: CFString::from_static_string("AXTitle"),
+        position: CFString::from_static_string("AXPosition"),
+        size: CFString::from_static_string("AXSize"),
+        windows: CFString::from_static_string("AXWindows"),
+        raise: CFString::from_static_string("AXRaise"),
+        window_created: CFString::from_static_string("AXWindowCreated"),
+        element_destroyed: CFString::from_static_string("AXUIElementDestroyed"),
+        focused_window_changed: CFString::from_static_string("AXFocusedWindowChanged"),
+        title_changed: CFString::from_static_string("AXTitleChanged"),
+    })
+}
+
+/// Attributes of a window that rarely change.
+/// The owning PID is not cached: `AXUIElementGetPid` is answered locally.
+#[derive(Debug, Clone, Default)]
+struct WindowMetadata {
+    /// The AXRole attribute, e.g. `AXWindow`.
+    role: Option<String>,
+    /// The AXSubrole attribute, e.g. `AXStandardWindow`.
+    subrole: Option<String>,
+    /// The AXTitle attribute.
+    title: Option<String>,
+    /// The frame when the window appeared, used to place it on the display it opened on.
+    frame: Option<Rect>,
+    /// The action of the rule that matched the window when it appeared.
+    rule: Option<RuleAction>,
+}
+
+/// Metadata of every known window, read when the window appears and kept until it goes away.
+#[derive(Default)]
+struct MetadataCache {
+    windows: Mutex<HashMap<WindowId, WindowMetadata>>,
+    /// Evaluated against each window as its metadata is loaded.
+    rules: RwLock<Arc<RuleSet>>,
+}
+
+impl MetadataCache {
+    /// Returns the cached metadata, reading it from the window on a miss.
+    fn get_or_load(&self, window: WindowId) -> Option<WindowMetadata> {
+        if let Some(metadata) = self.windows.lock().unwrap().get(&window) {
+            return Some(metadata.clone());
+        }
+        self.load(window)
+    }
+
+    /// Reads every attribute from the window, evaluates the rules against it and caches the result.
+    fn load(&self, window: WindowId) -> Option<WindowMetadata> {
+        let mut metadata = unsafe { MacOsBackend::read_metadata(window)? };
+        let rules = self.rules.read().unwrap().clone();
+        if !rules.is_empty() {
+            let (bundle_id, app) = MacOsBackend::window_pid(window).map(MacOsBackend::app_identity).unwrap_or_default();
+            metadata.rule = rules.evaluate(RuleSubject {
+                bundle_id: bundle_id.as_deref(),
+                app: app.as_deref(),
+                title: metadata.title.as_deref(),
+            });
+            if let Some(action) = metadata.rule {
+                log::debug!("Rule {:?} matched {:?} ({:?}, {:?})", action, window, bundle_id, app);
+            }
+        }
+        self.windows.lock().unwrap().insert(window, metadata.clone());
+        Some(metadata)
+    }
+
+    /// Re-reads the title of a cached window. Returns `false` if the window is not cached.
+    fn refresh_title(&self, window: WindowId) -> bool {
+        let Some(element) = handles().element(window) else {
+            return false;
+        };
+        let title = unsafe { MacOsBackend::copy_string(element.as_ptr(), &keys().title) };
+        match self.windows.lock().unwrap().get_mut(&window) {
+            Some(metadata) => {
+                metadata.title = title;
+                true
+            }
+            None => false,
+        }
+    }
+
+    /// Returns the cached rule result of a window.
+    fn rule(&self, window: WindowId) -> Option<RuleAction> {
+        self.get_or_load(window).and_then(|metadata| metadata.rule)
+    }
+
+    /// Returns the cached title of a window, without messaging the application.
+    fn title(&self, window: WindowId) -> Option<String> {
+        self.windows.lock().unwrap().get(&window).and_then(|metadata| metadata.title.clone())
+    }
+
+    /// Returns the cached opening frame of a window, without messaging the application.
+    fn frame(&self, window: WindowId) -> Option<Rect> {
+        self.windows.lock().unwrap().get(&window).and_then(|metadata| metadata.frame)
+    }
+
+    /// Forgets a window that went away.
+    fn remove(&self, window: WindowId) {
+        self.windows.lock().unwrap().remove(&window);
+    }
+}
+
+/// An application's Accessibility observer and the windows reported for it.
+struct AppObserver {
+    /// Delivers the application's notifications on the observer thread's run loop.
+    observer: AXObserverRef,
+    /// The application element the notifications are registered on; retained.
+    element: AXUIElementRef,
+    /// Windows reported as created and not yet destroyed or released.
+    windows: HashSet<WindowId>,
+}
+
+// Retaining, releasing and unregistering CoreFoundation objects is thread-safe; the table is
+// only touched under its lock.
+unsafe impl Send for AppObserver {}
+
+/// Observers of the applications we watch, keyed by PID. Filled at startup and as
+/// applications launch; entries are torn down when their application terminates.
+#[derive(Default)]
+struct AppTable {
+    apps: Mutex<HashMap<i32, AppObserver>>,
+}
+
+impl AppTable {
+    /// Checks if an application is already observed.
+    fn contains(&self, pid: i32) -> bool {
+        self.apps.lock().unwrap().contains_key(&pid)
+    }
+
+    /// Records the observer of an application.
+    fn insert(&self, pid: i32, observer: AXObserverRef, element: AXUIElementRef) {
+        let app = AppObserver { observer, element, windows: HashSet::new() };
+        self.apps.lock().unwrap().insert(pid, app);
+    }
+
+    /// Records a window reported for its application.
+    fn track(&self, window: WindowId) {
+        let Some(pid) = MacOsBackend::window_pid(window) else {
+            return;
+        };
+        if let Some(app) = self.apps.lock().unwrap().get_mut(&pid) {
+            app.windows.insert(window);
+        }
+    }
+
+    /// Forgets a window that went away or was released.
+    fn untrack(&self, window: WindowId) {
+        let Some(pid) = MacOsBackend::window_pid(window) else {
+            return;
+        };
+        if let Some(app) = self.apps.lock().unwrap().get_mut(&pid) {
+            app.windows.remove(&window);
+        }
+    }
+
+    /// Removes an application's entry, returning it for teardown.
+    fn remove(&self, pid: i32) -> Option<AppObserver> {
+        self.apps.lock().unwrap().remove(&pid)
+    }
+}
+
+/// State shared with the Accessibility and display callbacks through their refcon pointer.
+struct ObserverContext {
+    /// Queue into the Window Manager.
+    sender: EventSender,
+    /// Filled in as windows appear, so the manager never waits on it.
+    metadata: Arc<MetadataCache>,
+    /// Observers by PID, also reached from the NSWorkspace notification handlers.
+    apps: Arc<AppTable>,
+    /// The observer thread's run loop, where every application's observer is scheduled.
+    run_loop: OnceLock<CFRunLoop>,
+}
+
+impl ObserverContext {
+    /// Drops a window that could not be handed to the manager, releasing its element.
+    fn forget(&self, window: WindowId) {
+        self.metadata.remove(window);
+        self.apps.untrack(window);
+        handles().release(window);
+    }
+}
+
+/// A wrapper for the observer context to allow passing it across thread boundaries.
+struct RawContext(*mut ObserverContext);
+unsafe impl Send for RawContext {}
+unsafe impl Sync for RawContext {}
 
 impl MacOsBackend {
+    /// Creates the backend with an empty metadata cache.
+    pub fn new() -> Self {
+        Self { metadata: Arc::new(MetadataCache::default()), apps: Arc::new(AppTable::default()) }
+    }
+
+    /// Runs the main thread's run loop, where AppKit delivers NSWorkspace notifications,
+    /// until `stop_main_loop` is called. Must be called on the main thread, which it blocks.
+    pub fn run_main_loop() {
+        while !MAIN_LOOP_STOPPED.load(Ordering::Acquire) {
+            // Run in slices so a stop request is noticed even before any source is attached.
+            let result = unsafe { CFRunLoop::run_in_mode(kCFRunLoopDefaultMode, MAIN_LOOP_SLICE, false) };
+            if result == kCFRunLoopRunFinished {
+                thread::sleep(MAIN_LOOP_SLICE);
+            }
+        }
+    }
+
+    /// Ends `run_main_loop`. May be called from any thread.
+    pub fn stop_main_loop() {
+        MAIN_LOOP_STOPPED.store(true, Ordering::Release);
+        CFRunLoop::get_main().stop();
+    }
+
+    /// Returns the bundle identifier and localized name of the application with `pid`.
+    fn app_identity(pid: i32) -> (Option<String>, Option<String>) {
+        match NSRunningApplication::runningApplicationWithProcessIdentifier(pid) {
+            Some(app) => (
+                app.bundleIdentifier().map(|id| id.to_string()),
+                app.localizedName().map(|name| name.to_string()),
+            ),
+            None => (None, None),
+        }
+    }
+
     /// Checks if the current process has accessibility permissions.
     /// If `prompt` is true, triggers a system dialog if permissions are missing.
     pub fn is_trusted(prompt: bool) -> bool {
@@ -64,33 +381,83 @@ unsafe extern "C" fn observer_callback(
 ) {
     if element.is_null() { return; }
 
-    let sender = &*(refcon as *const Sender<SystemEvent>);
-    let notification_str = CFString::wrap_under_get_rule(notification).to_string();
+    let context = &*(refcon as *const ObserverContext);
+    // Compared against the interned keys, without converting to a Rust string.
+    let notification = CFString::wrap_under_get_rule(notification);
+    let keys = keys();
     
-    // We use the pointer address as the unique WindowId.
-    let window_id = WindowId(element as usize);
-
-    let event = match notification_str.as_str() {
-        "AXWindowCreated" => {
-            // Retain the window element to ensure it stays alive while we manage it.
-            core_foundation::base::CFRetain(element as _);
-            Some(SystemEvent::WindowCreated(window_id))
-        }
-        "AXUIElementDestroyed" => Some(SystemEvent::WindowDestroyed(window_id)),
-        "AXFocusedWindowChanged" => Some(SystemEvent::WindowFocused(window_id)),
-        _ => None,
+    let event = if notification == keys.window_created {
+        // Interning retains the element; a window reported again keeps its id and is not
+        // reported twice.
+        match handles().intern(element) {
+            Some((window_id, true)) => {
+                // Read the window's attributes here, on the observer thread, so the manager never has to.
+                context.metadata.load(window_id);
+                context.apps.track(window_id);
+                Some(SystemEvent::WindowCreated(window_id))
+            }
+            _ => None,
+        }
+    } else if notification == keys.element_destroyed {
+        // Elements we never interned, such as sheets and buttons, are not our windows.
+        handles().lookup(element).map(|window_id| {
+            context.apps.untrack(window_id);
+            SystemEvent::WindowDestroyed(window_id)
+        })
+    } else if notification == keys.focused_window_changed {
+        handles().lookup(element).map(SystemEvent::WindowFocused)
+    } else if notification == keys.title_changed {
+        // Only windows we already know about are worth reporting.
+        handles()
+            .lookup(element)
+            .filter(|&window_id| context.metadata.refresh_title(window_id))
+            .map(SystemEvent::WindowTitleChanged)
+    } else {
+        None
     };
 
     if let Some(e) = event {
-        // Use try_send to avoid blocking the OS callback thread.
-        let _ = sender.try_send(e);
+        // The queue never blocks the OS callback thread. If the manager is gone,
+        // drop the reference we just took so the element does not leak.
+        let created = match e {
+            SystemEvent::WindowCreated(window_id) => Some(window_id),
+            _ => None,
+        };
+        if let (false, Some(window_id)) = (context.sender.send(e), created) {
+            context.forget(window_id);
+        }
+    }
+}
+
+/// Returns the application a NSWorkspace notification is about.
+unsafe fn notification_app(notification: NonNull<NSNotification>) -> Option<objc2::rc::Retained<NSRunningApplication>> {
+    let info = notification.as_ref().userInfo()?;
+    let app = info.objectForKey(NSWorkspaceApplicationKey)?;
+    app.downcast::<NSRunningApplication>().ok()
+}
+
+/// Callback invoked by CoreGraphics when displays are connected, disconnected or rearranged.
+unsafe extern "C" fn display_reconfiguration_callback(display: u32, flags: u32, user_info: *mut c_void) {
+    // Every change is reported twice; only react once it has been applied.
+    if flags & DISPLAY_BEGIN_CONFIGURATION_FLAG != 0 {
+        return;
     }
+    let sender = &(*(user_info as *const ObserverContext)).sender;
+    let id = MonitorId(display as usize);
+    let event = if flags & DISPLAY_ADD_FLAG != 0 {
+        SystemEvent::MonitorAdded(id)
+    } else if flags & DISPLAY_REMOVE_FLAG != 0 {
+        SystemEvent::MonitorRemoved(id)
+    } else {
+        SystemEvent::MonitorChanged(id)
+    };
+    sender.send(event);
 }
 
 #[async_trait]
 impl WindowManagerBackend for MacOsBackend {
     /// Subscribes to window system events (creation, destruction, focus changes).
-    async fn subscribe(&self, event_sender: Sender<SystemEvent>) {
+    async fn subscribe(&self, event_sender: EventSender) {
         // Ensure we have permissions before starting.
         if !Self::is_trusted(true) {
             log::error!("Accessibility permissions not granted! A prompt should have appeared.");
@@ -113,18 +480,52 @@ impl WindowManagerBackend for MacOsBackend {
             pids
         };
 
-        let sender_ptr = RawSender(Box::into_raw(Box::new(event_sender)));
+        let context = ObserverContext {
+            sender: event_sender,
+            metadata: self.metadata.clone(),
+            apps: self.apps.clone(),
+            run_loop: OnceLock::new(),
+        };
+        let context_ptr = Box::into_raw(Box::new(context));
+        let thread_ptr = RawContext(context_ptr);
+        let (ready_tx, ready_rx) = std_mpsc::channel();
 
         // Run the macOS event loop in a dedicated background thread.
         thread::spawn(move || {
-            let inner_ptr = sender_ptr; 
+            let inner_ptr = thread_ptr;
             unsafe {
-                // 1. Setup observers for the captured PIDs.
-                for pid in pids {
-                    Self::setup_observer(pid, inner_ptr.0);
-                    
-                    // Discover windows that were already open before the observer was attached.
-                    Self::discover_existing_windows(pid, inner_ptr.0);
+                // Observers of applications launched later are scheduled on this run loop too.
+                let _ = (*inner_ptr.0).run_loop.set(CFRunLoop::get_current());
+                let _ = ready_tx.send(());
+
+                // Display changes arrive on this thread's run loop as well.
+                let err = CGDisplayRegisterReconfigurationCallback(
+                    display_reconfiguration_callback,
+                    inner_ptr.0 as *mut c_void,
+                );
+                if err != 0 {
+                    log::error!("Failed to register for display changes: {}", err);
+                }
+
+                // 1. Setup observers for the captured PIDs. Creating an observer does not
+                // message the application, so this is quick.
+                let observed: Vec<i32> = pids.into_iter().filter(|&pid| Self::setup_observer(pid, inner_ptr.0)).collect();
+
+                // 2. Discover windows that were already open before the observers were attached,
+                // all applications at once, and hand them to the manager as a single batch.
+                let context = &*inner_ptr.0;
+                let started = std::time::Instant::now();
+                let windows = Self::discover_all_windows(&observed, inner_ptr.0);
+                log::info!(
+                    "Discovered {} window(s) across {} application(s) in {:?}",
+                    windows.len(),
+                    observed.len(),
+                    started.elapsed()
+                );
+                if !context.sender.send(SystemEvent::WindowsDiscovered(windows.clone())) {
+                    for window in windows {
+                        context.forget(window);
+                    }
                 }
                 
                 log::info!("macOS Accessibility integration active.");
@@ -132,106 +533,196 @@ impl WindowManagerBackend for MacOsBackend {
                 CFRunLoop::run_current();
             }
         });
+
+        // 2. Follow applications launched and terminated from now on, once there is a run
+        // loop to schedule their observers on.
+        if ready_rx.recv().is_ok() {
+            unsafe { Self::observe_app_lifecycle(context_ptr) };
+        }
     }
 
     /// Moves and resizes a window to the specified rectangle using Accessibility APIs.
     fn set_window_rect(&self, window: WindowId, rect: Rect) -> Result<()> {
-        if window.0 == 0 { return Ok(()); }
-        log::info!("macOS: Moving window {:?} to {:?}", window, rect);
-        
-        unsafe {
-            let window_ref = window.0 as AXUIElementRef;
-            
-            // Defensive check: is the window still valid?
-            let mut pid: i32 = 0;
-            if accessibility_sys::AXUIElementGetPid(window_ref, &mut pid) != 0 {
-                return Ok(());
+        self.set_window_frame(window, rect, FrameChange::Both)
+    }
+
+    /// Sends only the AXPosition and/or AXSize attribute that actually changed.
+    /// Each attribute is a separate IPC round trip into the target application.
+    fn set_window_frame(&self, window: WindowId, rect: Rect, change: FrameChange) -> Result<()> {
+        // Defensive check: is the window still valid?
+        if Self::window_pid(window).is_none() {
+            return Ok(());
+        }
+        unsafe { Self::apply_frame(window, rect, change) }
+    }
+
+    /// Applies a layout pass, moving the windows of different applications in parallel.
+    ///
+    /// Windows are grouped by PID and each group is handled by one of at most
+    /// `FRAME_WORKERS` threads, so a slow application only delays its own windows.
+    /// Once a call into an application times out, its remaining windows are skipped.
+    fn apply_frames(&self, frames: &[(WindowId, Rect, FrameChange)]) -> Vec<WindowId> {
+        let mut failed = Vec::new();
+        let mut by_pid: HashMap<i32, Vec<(WindowId, Rect, FrameChange)>> = HashMap::new();
+        for &frame in frames {
+            match Self::window_pid(frame.0) {
+                Some(pid) => by_pid.entry(pid).or_default().push(frame),
+                None => failed.push(frame.0),
             }
+        }
 
-            // Set window position (AXPosition attribute).
-            let pos = CGPoint { x: rect.min_x() as f64, y: rect.min_y() as f64 };
-            let pos_value = accessibility_sys::AXValueCreate(
-                accessibility_sys::kAXValueTypeCGPoint,
-                &pos as *const _ as *const _,
-            );
-            if !pos_value.is_null() {
-                let attr = CFString::new("AXPosition");
-                accessibility_sys::AXUIElementSetAttributeValue(
-                    window_ref,
-                    attr.as_concrete_TypeRef(),
-                    pos_value as _,
-                );
-                CFRelease(pos_value as _);
+        let groups: Vec<(i32, Vec<(WindowId, Rect, FrameChange)>)> = by_pid.into_iter().collect();
+        let workers = groups.len().min(FRAME_WORKERS);
+        if workers <= 1 {
+            for (pid, group) in &groups {
+                failed.extend(Self::apply_app_frames(*pid, group));
             }
+            return failed;
+        }
 
-            // Set window size (AXSize attribute).
-            let size = CGSize { width: rect.width() as f64, height: rect.height() as f64 };
-            let size_value = accessibility_sys::AXValueCreate(
-                accessibility_sys::kAXValueTypeCGSize,
-                &size as *const _ as *const _,
-            );
-            if !size_value.is_null() {
-                let attr = CFString::new("AXSize");
-                accessibility_sys::AXUIElementSetAttributeValue(
-                    window_ref,
-                    attr.as_concrete_TypeRef(),
-                    size_value as _,
-                );
-                CFRelease(size_value as _);
+        // Workers pull whole applications off a shared queue until it is drained.
+        let (tx, rx) = crossbeam_channel::unbounded();
+        for group in &groups {
+            let _ = tx.send(group);
+        }
+        drop(tx);
+
+        // Workers report their calls under the caller's span.
+        let span = tracing::Span::current();
+        thread::scope(|scope| {
+            let handles: Vec<_> = (0..workers)
+                .map(|_| {
+                    let rx = rx.clone();
+                    let span = span.clone();
+                    scope.spawn(move || {
+                        span.in_scope(|| {
+                            let mut failed = Vec::new();
+                            for (pid, group) in rx.iter() {
+                                failed.extend(Self::apply_app_frames(*pid, group));
+                            }
+                            failed
+                        })
+                    })
+                })
+                .collect();
+            for handle in handles {
+                failed.extend(handle.join().unwrap_or_default());
+            }
+        });
+        failed
+    }
+
+    /// Lists active displays via CoreGraphics, with the main display first, each with its
+    /// visible frame: the area the menu bar and the Dock leave free. Frames are in the same
+    /// top-left-origin global coordinates as AXPosition.
+    fn monitors(&self) -> Vec<(MonitorId, Rect)> {
+        let visible = Self::visible_frames();
+        let mut ids = [0u32; MAX_DISPLAYS];
+        let mut count = 0u32;
+        unsafe {
+            if CGGetActiveDisplayList(MAX_DISPLAYS as u32, ids.as_mut_ptr(), &mut count) != 0 {
+                log::error!("Failed to query active displays");
+                return Vec::new();
+            }
+            let main = CGMainDisplayID();
+            let mut monitors: Vec<(MonitorId, Rect)> = ids[..count as usize]
+                .iter()
+                .map(|&id| {
+                    let bounds = CGDisplayBounds(id);
+                    let rect = Rect::new(
+                        Point::new(bounds.origin.x as i32, bounds.origin.y as i32),
+                        Size::new(bounds.size.width as i32, bounds.size.height as i32),
+                    );
+                    // Screens are matched to displays by their full frame.
+                    let rect = visible
+                        .iter()
+                        .find(|(frame, _)| *frame == rect)
+                        .map_or(rect, |&(_, visible)| visible);
+                    (MonitorId(id as usize), rect)
+                })
+                .collect();
+            monitors.sort_by_key(|&(id, _)| id.0 != main as usize);
+            monitors
+        }
+    }
+
+    /// Reads the window's AXPosition and AXSize.
+    fn get_window_rect(&self, window: WindowId) -> Option<Rect> {
+        let element = handles().element(window)?;
+        let window_ref = element.as_ptr();
+        unsafe {
+            accessibility_sys::AXUIElementSetMessagingTimeout(window_ref, AX_MESSAGING_TIMEOUT_SECS);
+            Self::read_frame(window_ref)
+        }
+    }
+
+    /// Answered from the metadata cache, filled on the observer thread when the window appeared.
+    fn opening_rect(&self, window: WindowId) -> Option<Rect> {
+        self.metadata.frame(window)
+    }
+
+    /// Performs the AXRaise action on the window.
+    fn raise_window(&self, window: WindowId) -> Result<()> {
+        let Some(element) = handles().element(window) else {
+            return Ok(());
+        };
+        let window_ref = element.as_ptr();
+        unsafe {
+            accessibility_sys::AXUIElementSetMessagingTimeout(window_ref, AX_MESSAGING_TIMEOUT_SECS);
+            let err = accessibility_sys::AXUIElementPerformAction(window_ref, keys().raise.as_concrete_TypeRef());
+            if err != 0 {
+                anyhow::bail!("AXRaise failed for {:?}: {}", window, err);
             }
         }
-        
         Ok(())
     }
 
     /// Determines if a window should be managed by the window manager.
     /// Filters out tooltips, popups, and other non-standard windows.
     fn is_manageable(&self, window: WindowId) -> bool {
-        if window.0 == 0 { return false; }
-        unsafe {
-            let window_ref = window.0 as AXUIElementRef;
-            
-            // Defensive check: is the window still valid?
-            let mut pid: i32 = 0;
-            if accessibility_sys::AXUIElementGetPid(window_ref, &mut pid) != 0 {
-                return false;
-            }
-
-            // Check Role (should be AXWindow).
-            let mut role: *const c_void = ptr::null();
-            if accessibility_sys::AXUIElementCopyAttributeValue(
-                window_ref,
-                CFString::new("AXRole").as_concrete_TypeRef(),
-                &mut role,
-            ) == 0 {
-                if !role.is_null() {
-                    let role_str = CFString::wrap_under_create_rule(role as _).to_string();
-                    if role_str != "AXWindow" {
-                        log::debug!("Filtering window {:?} with role {}", window, role_str);
-                        return false;
-                    }
-                }
-            }
+        // Defensive check: is the window still valid? Answered locally.
+        if Self::window_pid(window).is_none() {
+            return false;
+        }
+        // Usually filled in by the observer thread when the window appeared.
+        let Some(metadata) = self.metadata.get_or_load(window) else {
+            return false;
+        };
 
-            // Check Subrole (should be AXStandardWindow).
-            // This filters out things like "AXSystemDialog" or "AXUnknown".
-            let mut subrole: *const c_void = ptr::null();
-            if accessibility_sys::AXUIElementCopyAttributeValue(
-                window_ref,
-                CFString::new("AXSubrole").as_concrete_TypeRef(),
-                &mut subrole,
-            ) == 0 {
-                if !subrole.is_null() {
-                    let subrole_str = CFString::wrap_under_create_rule(subrole as _).to_string();
-                    if subrole_str != "AXStandardWindow" {
-                        log::debug!("Filtering window {:?} with subrole {}", window, subrole_str);
-                        return false;
-                    }
-                }
-            }
+        // Check Role (should be AXWindow).
+        if let Some(role) = metadata.role.as_deref().filter(|role| *role != "AXWindow") {
+            log::debug!("Filtering window {:?} with role {}", window, role);
+            return false;
+        }
 
-            true
+        // Check Subrole (should be AXStandardWindow).
+        // This filters out things like "AXSystemDialog" or "AXUnknown".
+        if let Some(subrole) = metadata.subrole.as_deref().filter(|subrole| *subrole != "AXStandardWindow") {
+            log::debug!("Filtering window {:?} with subrole {}", window, subrole);
+            return false;
         }
+
+        true
+    }
+
+    /// Swaps in the new rules; windows already cached keep the result they were given.
+    fn set_rules(&self, rules: Arc<RuleSet>) {
+        *self.metadata.rules.write().unwrap() = rules;
+    }
+
+    /// Returns the rule result cached when the window's metadata was loaded.
+    fn window_rule(&self, window: WindowId) -> Option<RuleAction> {
+        self.metadata.rule(window)
+    }
+
+    /// Returns the cached title; kept current by AXTitleChanged notifications.
+    fn window_title(&self, window: WindowId) -> Option<String> {
+        self.metadata.title(window)
+    }
+
+    /// Answered from the handle registry.
+    fn window_pid(&self, window: WindowId) -> Option<i32> {
+        Self::window_pid(window)
     }
 
     /// Not currently implemented on macOS. Returns a stub.
@@ -239,91 +730,427 @@ impl WindowManagerBackend for MacOsBackend {
         Ok(WindowId(0))
     }
 
-    /// Releases our retained reference to the window element.
+    /// Releases our retained reference to the window element and forgets its metadata.
     fn release_window(&self, window: WindowId) {
-        if window.0 != 0 {
-            unsafe {
-                core_foundation::base::CFRelease(window.0 as _);
-            }
-        }
+        self.metadata.remove(window);
+        self.apps.untrack(window);
+        handles().release(window);
     }
 }
 
 impl MacOsBackend {
-    /// Attaches an accessibility observer to a specific process PID.
-    unsafe fn setup_observer(pid: i32, sender_ptr: *mut Sender<SystemEvent>) {
+    /// Returns the full and the visible frame of every screen, in top-left-origin global
+    /// coordinates. `NSScreen` may only be used on the main thread, so from other threads
+    /// the query runs on the main operation queue; the list is empty if it does not answer
+    /// within `MAIN_THREAD_TIMEOUT`.
+    fn visible_frames() -> Vec<(Rect, Rect)> {
+        if let Some(mtm) = MainThreadMarker::new() {
+            return Self::screen_frames(mtm);
+        }
+        let (tx, rx) = std_mpsc::channel();
+        let query = RcBlock::new(move || {
+            if let Some(mtm) = MainThreadMarker::new() {
+                let _ = tx.send(Self::screen_frames(mtm));
+            }
+        });
+        unsafe { NSOperationQueue::mainQueue().addOperationWithBlock(&query) };
+        rx.recv_timeout(MAIN_THREAD_TIMEOUT).unwrap_or_else(|_| {
+            log::warn!("Main thread did not report the visible screen frames; tiling full displays");
+            Vec::new()
+        })
+    }
+
+    /// Reads the frames of every screen. Runs on the main thread.
+    fn screen_frames(mtm: MainThreadMarker) -> Vec<(Rect, Rect)> {
+        let screens = NSScreen::screens(mtm);
+        // Cocoa measures up from the bottom-left corner of the primary screen, listed first.
+        let Some(primary_height) = screens.firstObject().map(|screen| screen.frame().size.height) else {
+            return Vec::new();
+        };
+        let flip = |rect: NSRect| {
+            Rect::new(
+                Point::new(rect.origin.x.round() as i32, (primary_height - rect.origin.y - rect.size.height).round() as i32),
+                Size::new(rect.size.width.round() as i32, rect.size.height.round() as i32),
+            )
+        };
+        screens.iter().map(|screen| (flip(screen.frame()), flip(screen.visibleFrame()))).collect()
+    }
+
+    /// Returns the PID owning a window, or `None` if its id has been released.
+    /// This is answered from the handle registry and does not message the target application.
+    fn window_pid(window: WindowId) -> Option<i32> {
+        handles().pid(window)
+    }
+
+    /// Applies the frames of a single application in order.
+    /// Returns the windows that were not updated because the application stopped responding.
+    /// Each call's latency is recorded in the application's `set_frame` histogram.
+    fn apply_app_frames(pid: i32, frames: &[(WindowId, Rect, FrameChange)]) -> Vec<WindowId> {
+        let _span = tracing::debug_span!("set_frames", pid, windows = frames.len()).entered();
+        let latency = metrics().app(pid);
+        for (i, &(window, rect, change)) in frames.iter().enumerate() {
+            let started = std::time::Instant::now();
+            let result = unsafe { Self::apply_frame(window, rect, change) };
+            latency.record_duration(started.elapsed());
+            if let Err(e) = result {
+                log::warn!("{}; skipping {} remaining window(s) of this app", e, frames.len() - i);
+                return frames[i..].iter().map(|frame| frame.0).collect();
+            }
+        }
+        Vec::new()
+    }
+
+    /// Sends the position and/or size of one window, bounded by `AX_MESSAGING_TIMEOUT_SECS`.
+    unsafe fn apply_frame(window: WindowId, rect: Rect, change: FrameChange) -> Result<()> {
+        log::trace!("macOS: Moving window {:?} to {:?} ({:?})", window, rect, change);
+        let Some(element) = handles().element(window) else {
+            return Ok(());
+        };
+        let window_ref = element.as_ptr();
+        accessibility_sys::AXUIElementSetMessagingTimeout(window_ref, AX_MESSAGING_TIMEOUT_SECS);
+
+        if change != FrameChange::Size && Self::set_position(window_ref, rect) == kAXErrorCannotComplete {
+            anyhow::bail!("Window {:?} did not respond to AXPosition", window);
+        }
+        if change != FrameChange::Position && Self::set_size(window_ref, rect) == kAXErrorCannotComplete {
+            anyhow::bail!("Window {:?} did not respond to AXSize", window);
+        }
+        Ok(())
+    }
+
+    /// Reads the attributes cached in `WindowMetadata`, three round trips into the
+    /// application. Returns `None` if the element is no longer valid.
+    unsafe fn read_metadata(window: WindowId) -> Option<WindowMetadata> {
+        let element = handles().element(window)?;
+        let window_ref = element.as_ptr();
+        accessibility_sys::AXUIElementSetMessagingTimeout(window_ref, AX_MESSAGING_TIMEOUT_SECS);
+        let keys = keys();
+        Some(WindowMetadata {
+            role: Self::copy_string(window_ref, &keys.role),
+            subrole: Self::copy_string(window_ref, &keys.subrole),
+            title: Self::copy_string(window_ref, &keys.title),
+            frame: Self::read_frame(window_ref),
+            rule: None,
+        })
+    }
+
+    /// Reads a window's AXPosition and AXSize.
+    unsafe fn read_frame(window_ref: AXUIElementRef) -> Option<Rect> {
+        let pos: CGPoint = Self::copy_value(window_ref, &keys().position, accessibility_sys::kAXValueTypeCGPoint)?;
+        let size: CGSize = Self::copy_value(window_ref, &keys().size, accessibility_sys::kAXValueTypeCGSize)?;
+        Some(Rect::new(
+            Point::new(pos.x as i32, pos.y as i32),
+            Size::new(size.width as i32, size.height as i32),
+        ))
+    }
+
+    /// Reads a string attribute such as AXTitle.
+    unsafe fn copy_string(window_ref: AXUIElementRef, attribute: &CFString) -> Option<String> {
+        let mut value: *const c_void = ptr::null();
+        if accessibility_sys::AXUIElementCopyAttributeValue(window_ref, attribute.as_concrete_TypeRef(), &mut value) != 0
+            || value.is_null()
+        {
+            return None;
+        }
+        Some(CFString::wrap_under_create_rule(value as _).to_string())
+    }
+
+    /// Reads an AXValue attribute (such as AXPosition) into the matching CoreGraphics struct.
+    unsafe fn copy_value<T: Default>(
+        window_ref: AXUIElementRef,
+        attribute: &CFString,
+        value_type: accessibility_sys::AXValueType,
+    ) -> Option<T> {
+        let mut value: *const c_void = ptr::null();
+        if accessibility_sys::AXUIElementCopyAttributeValue(window_ref, attribute.as_concrete_TypeRef(), &mut value) != 0
+            || value.is_null()
+        {
+            return None;
+        }
+        let mut out = T::default();
+        let ok = accessibility_sys::AXValueGetValue(value as _, value_type, &mut out as *mut T as *mut c_void);
+        CFRelease(value);
+        ok.then_some(out)
+    }
+
+    /// Sets the window position (AXPosition attribute).
+    unsafe fn set_position(window_ref: AXUIElementRef, rect: Rect) -> AXError {
+        let pos = CGPoint { x: rect.min_x() as f64, y: rect.min_y() as f64 };
+        let pos_value = accessibility_sys::AXValueCreate(
+            accessibility_sys::kAXValueTypeCGPoint,
+            &pos as *const _ as *const _,
+        );
+        if pos_value.is_null() {
+            return 0;
+        }
+        let err = accessibility_sys::AXUIElementSetAttributeValue(
+            window_ref,
+            keys().position.as_concrete_TypeRef(),
+            pos_value as _,
+        );
+        CFRelease(pos_value as _);
+        err
+    }
+
+    /// Sets the window size (AXSize attribute).
+    unsafe fn set_size(window_ref: AXUIElementRef, rect: Rect) -> AXError {
+        let size = CGSize { width: rect.width() as f64, height: rect.height() as f64 };
+        let size_value = accessibility_sys::AXValueCreate(
+            accessibility_sys::kAXValueTypeCGSize,
+            &size as *const _ as *const _,
+        );
+        if size_value.is_null() {
+            return 0;
+        }
+        let err = accessibility_sys::AXUIElementSetAttributeValue(
+            window_ref,
+            keys().size.as_concrete_TypeRef(),
+            size_value as _,
+        );
+        CFRelease(size_value as _);
+        err
+    }
+
+    /// Attaches an accessibility observer to a specific process PID, scheduled on the observer
+    /// thread's run loop, and records it in the app table. Returns `false` if the process
+    /// is already observed or cannot be.
+    unsafe fn setup_observer(pid: i32, context_ptr: *mut ObserverContext) -> bool {
+        let context = &*(context_ptr as *const ObserverContext);
+        if context.apps.contains(pid) {
+            return false;
+        }
+        let Some(run_loop) = context.run_loop.get() else {
+            log::error!("No observer run loop to attach PID {} to", pid);
+            return false;
+        };
+
         let mut observer: AXObserverRef = ptr::null_mut();
         let err = accessibility_sys::AXObserverCreate(pid, observer_callback, &mut observer);
+        if err != 0 || observer.is_null() {
+            log::error!("Failed to create AXObserver for PID {}: {}", pid, err);
+            return false;
+        }
+        let app_element = accessibility_sys::AXUIElementCreateApplication(pid);
+        if app_element.is_null() {
+            CFRelease(observer as _);
+            return false;
+        }
+
+        // We listen for creation, destruction, focus and title changes.
+        let keys = keys();
+        let notifications = [
+            &keys.window_created,
+            &keys.element_destroyed,
+            &keys.focused_window_changed,
+            &keys.title_changed,
+        ];
+
+        for note in notifications {
+            accessibility_sys::AXObserverAddNotification(
+                observer,
+                app_element,
+                note.as_concrete_TypeRef(),
+                context_ptr as *mut c_void,
+            );
+        }
+
+        // Integrate the observer's runloop source into the background thread's runloop.
+        // Adding a source to another thread's run loop is allowed, so this works from the
+        // NSWorkspace handlers on the main thread as well.
+        let source = accessibility_sys::AXObserverGetRunLoopSource(observer);
+        if !source.is_null() {
+            let source_ref = CFRunLoopSource::wrap_under_get_rule(source as _);
+            run_loop.add_source(&source_ref, kCFRunLoopDefaultMode);
+        }
+
+        // Kept until the application terminates; see `teardown_observer`.
+        context.apps.insert(pid, observer, app_element);
+        true
+    }
+
+    /// Detaches the observer of a terminated application and reports its remaining windows
+    /// as destroyed, so the manager drops them and releases their retained elements.
+    unsafe fn teardown_observer(pid: i32, context: &ObserverContext) {
+        let Some(app) = context.apps.remove(pid) else {
+            return;
+        };
+        metrics().forget_app(pid);
+        let source = accessibility_sys::AXObserverGetRunLoopSource(app.observer);
+        if let (false, Some(run_loop)) = (source.is_null(), context.run_loop.get()) {
+            let source_ref = CFRunLoopSource::wrap_under_get_rule(source as _);
+            run_loop.remove_source(&source_ref, kCFRunLoopDefaultMode);
+        }
+        CFRelease(app.observer as _);
+        CFRelease(app.element as _);
+
+        log::info!("PID {} terminated, dropping {} window(s)", pid, app.windows.len());
+        for window in app.windows {
+            context.sender.send(SystemEvent::WindowDestroyed(window));
+        }
+    }
+
+    /// Registers for NSWorkspace launch and terminate notifications.
+    /// AppKit delivers them on the main thread; see `run_main_loop`.
+    unsafe fn observe_app_lifecycle(context_ptr: *mut ObserverContext) {
+        let center = NSWorkspace::sharedWorkspace().notificationCenter();
 
-        if err == 0 && !observer.is_null() {
-            let app_element = accessibility_sys::AXUIElementCreateApplication(pid);
-            if app_element.is_null() {
-                CFRelease(observer as _);
+        let launch_ptr = RawContext(context_ptr);
+        let launched = RcBlock::new(move |notification: NonNull<NSNotification>| {
+            let Some(app) = notification_app(notification) else {
                 return;
+            };
+            if app.activationPolicy() != NSApplicationActivationPolicy::Regular {
+                return;
+            }
+            let pid = app.processIdentifier() as i32;
+            let context_ptr = launch_ptr.0;
+            if Self::setup_observer(pid, context_ptr) {
+                log::info!("Observing launched application (PID {})", pid);
+                let context = &*context_ptr;
+                for window in Self::discover_existing_windows(pid, context_ptr) {
+                    // Artificially trigger a WindowCreated event for existing windows.
+                    if !context.sender.send(SystemEvent::WindowCreated(window)) {
+                        context.forget(window);
+                    }
+                }
+                context.sender.send(SystemEvent::AppLaunched(pid));
             }
+        });
 
-            // We listen for creation, destruction, and focus changes.
-            let notifications = [
-                "AXWindowCreated",
-                "AXUIElementDestroyed",
-                "AXFocusedWindowChanged",
-            ];
-
-            for note in notifications {
-                let note_cf = CFString::new(note);
-                accessibility_sys::AXObserverAddNotification(
-                    observer,
-                    app_element,
-                    note_cf.as_concrete_TypeRef(),
-                    sender_ptr as *mut c_void,
-                );
+        let terminate_ptr = RawContext(context_ptr);
+        let terminated = RcBlock::new(move |notification: NonNull<NSNotification>| {
+            if let Some(app) = notification_app(notification) {
+                Self::teardown_observer(app.processIdentifier() as i32, &*terminate_ptr.0);
             }
+        });
+
+        // The notification center keeps both observers registered for the daemon's lifetime;
+        // the returned tokens would only be needed to unregister them.
+        let _ = center.addObserverForName_object_queue_usingBlock(
+            Some(NSWorkspaceDidLaunchApplicationNotification),
+            None,
+            None,
+            &launched,
+        );
+        let _ = center.addObserverForName_object_queue_usingBlock(
+            Some(NSWorkspaceDidTerminateApplicationNotification),
+            None,
+            None,
+            &terminated,
+        );
+    }
+
+    /// Discovers the existing windows of several processes in parallel.
+    ///
+    /// Applications are spread over at most `DISCOVERY_WORKERS` threads, so a busy
+    /// application only delays its own windows, each bounded by `DISCOVERY_TIMEOUT_SECS`.
+    unsafe fn discover_all_windows(pids: &[i32], context_ptr: *mut ObserverContext) -> Vec<WindowId> {
+        let workers = pids.len().min(DISCOVERY_WORKERS);
+        if workers <= 1 {
+            return pids.iter().flat_map(|&pid| Self::discover_existing_windows(pid, context_ptr)).collect();
+        }
+
+        // Workers pull applications off a shared queue until it is drained.
+        let (tx, rx) = crossbeam_channel::unbounded();
+        for &pid in pids {
+            let _ = tx.send(pid);
+        }
+        drop(tx);
+
+        let context = RawContext(context_ptr);
+        let context = &context;
+        thread::scope(|scope| {
+            let handles: Vec<_> = (0..workers)
+                .map(|_| {
+                    let rx = rx.clone();
+                    scope.spawn(move || {
+                        rx.iter()
+                            .flat_map(|pid| Self::discover_existing_windows(pid, context.0))
+                            .collect::<Vec<_>>()
+                    })
+                })
+                .collect();
+            handles.into_iter().flat_map(|handle| handle.join().unwrap_or_default()).collect()
+        })
+    }
 
-            // Integrate the observer's runloop source into the background thread's runloop.
-            let source = accessibility_sys::AXObserverGetRunLoopSource(observer);
-            if !source.is_null() {
-                let source_ref = CFRunLoopSource::wrap_under_get_rule(source as _);
-                CFRunLoop::get_current().add_source(&source_ref, kCFRunLoopDefaultMode);
+    /// Lists the existing windows of a process, retaining each one, reading its metadata and
+    /// recording it in the app table. The caller reports them to the WindowManager.
+    /// If the process does not answer in time, its windows are listed again in the background.
+    unsafe fn discover_existing_windows(pid: i32, context_ptr: *mut ObserverContext) -> Vec<WindowId> {
+        match Self::list_windows(pid, context_ptr) {
+            Some(found) => found,
+            None => {
+                log::warn!("PID {} did not list its windows in time; retrying in the background", pid);
+                Self::retry_discovery(pid, context_ptr);
+                Vec::new()
             }
-            
-            // Note: In a complete implementation, we'd need to store the observer
-            // and app_element to release them properly when the app exits.
-            // For now, they live until the process terminates.
-            CFRelease(app_element as _);
-        } else {
-            log::error!("Failed to create AXObserver for PID {}: {}", pid, err);
         }
     }
 
-    /// Iterates through all existing windows for a process and notifies the WindowManager.
-    unsafe fn discover_existing_windows(pid: i32, sender_ptr: *mut Sender<SystemEvent>) {
+    /// Lists the windows of a process again after each of `DISCOVERY_RETRIES`, until it
+    /// answers or terminates, and reports the windows found to the WindowManager. Windows
+    /// its observer reported in the meantime keep their id and are not reported twice.
+    unsafe fn retry_discovery(pid: i32, context_ptr: *mut ObserverContext) {
+        let context = RawContext(context_ptr);
+        thread::spawn(move || {
+            let context = context;
+            for delay in DISCOVERY_RETRIES {
+                thread::sleep(delay);
+                let observer_context = &*context.0;
+                if !observer_context.apps.contains(pid) {
+                    return;
+                }
+                let Some(found) = Self::list_windows(pid, context.0) else {
+                    continue;
+                };
+                log::info!("PID {} listed {} window(s) on retry", pid, found.len());
+                for window in found {
+                    if !observer_context.sender.send(SystemEvent::WindowCreated(window)) {
+                        observer_context.forget(window);
+                    }
+                }
+                return;
+            }
+            log::warn!("PID {} never listed its windows; only windows it creates from now on are tiled", pid);
+        });
+    }
+
+    /// Lists and interns the windows of a process; see `discover_existing_windows`.
+    /// Returns `None` if the process did not answer within `DISCOVERY_TIMEOUT_SECS`.
+    unsafe fn list_windows(pid: i32, context_ptr: *mut ObserverContext) -> Option<Vec<WindowId>> {
+        let mut found = Vec::new();
         let app_element = accessibility_sys::AXUIElementCreateApplication(pid);
-        if app_element.is_null() { return; }
+        if app_element.is_null() { return Some(found); }
+        accessibility_sys::AXUIElementSetMessagingTimeout(app_element, DISCOVERY_TIMEOUT_SECS);
 
         let mut windows: *const c_void = ptr::null();
         
         // Query the "AXWindows" attribute for the application.
-        if accessibility_sys::AXUIElementCopyAttributeValue(
+        let err = accessibility_sys::AXUIElementCopyAttributeValue(
             app_element,
-            CFString::new("AXWindows").as_concrete_TypeRef(),
+            keys().windows.as_concrete_TypeRef(),
             &mut windows,
-        ) == 0 {
-            if !windows.is_null() {
-                let windows_cf = core_foundation::array::CFArray::<*const c_void>::wrap_under_create_rule(windows as _);
-                let sender = &*(sender_ptr as *const Sender<SystemEvent>);
-                
-                for win in windows_cf.iter() {
-                    if win.is_null() { continue; }
-                    
-                    // Retain the window reference so it survives being sent to the WindowManager.
-                    core_foundation::base::CFRetain(*win);
-                    
-                    let window_id = WindowId(*win as usize);
-                    // Artificially trigger a WindowCreated event for existing windows.
-                    let _ = sender.try_send(SystemEvent::WindowCreated(window_id));
-                }
+        );
+        if err == kAXErrorCannotComplete {
+            CFRelease(app_element as _);
+            return None;
+        } else if err == 0 && !windows.is_null() {
+            let windows_cf = core_foundation::array::CFArray::<*const c_void>::wrap_under_create_rule(windows as _);
+            let context = &*(context_ptr as *const ObserverContext);
+
+            for win in windows_cf.iter() {
+                // Interning retains the element so it survives being sent to the WindowManager.
+                // A window already reported by its observer is not reported again.
+                let Some((window_id, true)) = handles().intern(*win as AXUIElementRef) else {
+                    continue;
+                };
+                context.metadata.load(window_id);
+                context.apps.track(window_id);
+                found.push(window_id);
             }
         }
         CFRelease(app_element as _);
+        Some(found)
     }
 }
@@ -0,0 +1,98 @@
+//! Headless implementation of the WindowManagerBackend trait.
+//!
+//! Keeps window frames in memory and sleeps for a configurable time in every frame call,
+//! standing in for the round trip into the owning application. Events are not generated
+//! here: whoever drives the manager, such as `replay`, queues them directly.
+
+use async_trait::async_trait;
+use crate::platform::{WindowManagerBackend, FrameChange};
+use crate::core::geometry::Rect;
+use crate::core::types::{MonitorId, WindowId};
+use crate::core::queue::EventSender;
+use crate::config::rules::{RuleAction, RuleSet};
+use anyhow::Result;
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread;
+use std::time::Duration;
+
+/// A backend without a desktop behind it.
+pub struct MockBackend {
+    /// The displays reported to the manager, primary first.
+    displays: Vec<(MonitorId, Rect)>,
+    /// How long each frame call takes.
+    latency: Duration,
+    /// The last frame applied to each window.
+    frames: Mutex<HashMap<WindowId, Rect>>,
+    /// Number of frame calls made.
+    calls: AtomicU64,
+}
+
+impl MockBackend {
+    /// Creates a backend reporting `displays` whose frame calls each take `latency`.
+    pub fn new(displays: Vec<(MonitorId, Rect)>, latency: Duration) -> Self {
+        Self { displays, latency, frames: Mutex::new(HashMap::new()), calls: AtomicU64::new(0) }
+    }
+
+    /// Returns the number of frame calls made so far.
+    pub fn frame_calls(&self) -> u64 {
+        self.calls.load(Ordering::Relaxed)
+    }
+}
+
+#[async_trait]
+impl WindowManagerBackend for MockBackend {
+    /// Nothing to observe; events are queued by the caller.
+    async fn subscribe(&self, event_sender: EventSender) {
+        let _ = event_sender;
+    }
+
+    /// Records the frame after waiting for the configured latency.
+    fn set_window_rect(&self, window: WindowId, rect: Rect) -> Result<()> {
+        self.set_window_frame(window, rect, FrameChange::Both)
+    }
+
+    /// Records the frame after waiting for the configured latency.
+    fn set_window_frame(&self, window: WindowId, rect: Rect, change: FrameChange) -> Result<()> {
+        log::trace!("Mock: Moving window {:?} to {:?} ({:?})", window, rect, change);
+        if !self.latency.is_zero() {
+            thread::sleep(self.latency);
+        }
+        self.calls.fetch_add(1, Ordering::Relaxed);
+        self.frames.lock().unwrap().insert(window, rect);
+        Ok(())
+    }
+
+    fn monitors(&self) -> Vec<(MonitorId, Rect)> {
+        self.displays.clone()
+    }
+
+    fn get_window_rect(&self, window: WindowId) -> Option<Rect> {
+        self.frames.lock().unwrap().get(&window).copied()
+    }
+
+    /// Rules need an application to match; mock windows have none.
+    fn set_rules(&self, rules: Arc<RuleSet>) {
+        let _ = rules;
+    }
+
+    fn window_rule(&self, window: WindowId) -> Option<RuleAction> {
+        let _ = window;
+        None
+    }
+
+    /// Every mock window is a normal application window.
+    fn is_manageable(&self, window: WindowId) -> bool {
+        let _ = window;
+        true
+    }
+
+    fn get_focused_window(&self) -> Result<WindowId> {
+        Ok(WindowId(0))
+    }
+
+    fn release_window(&self, window: WindowId) {
+        self.frames.lock().unwrap().remove(&window);
+    }
+}
@@ -4,10 +4,39 @@
 //! interface for interacting with different operating system windowing systems.
 
 use async_trait::async_trait;
-use crate::core::geometry::Rect;
-use crate::core::types::{WindowId, SystemEvent};
-use tokio::sync::mpsc::Sender;
+use crate::core::geometry::{Point, Rect, Size};
+use crate::core::types::{MonitorId, WindowId};
+use crate::core::queue::EventSender;
+use crate::config::rules::{RuleAction, RuleSet};
 use anyhow::Result;
+use std::sync::Arc;
+
+/// The parts of a window's frame that differ from what was last applied to it.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum FrameChange {
+    /// Only the origin moved; the size is unchanged.
+    Position,
+    /// Only the size changed; the origin is unchanged.
+    Size,
+    /// Both the origin and the size changed.
+    Both,
+}
+
+impl FrameChange {
+    /// Compares the last applied rectangle with a new one.
+    /// Returns `None` if the window is already where it should be.
+    pub fn between(applied: Option<Rect>, target: Rect) -> Option<Self> {
+        let Some(applied) = applied else {
+            return Some(FrameChange::Both);
+        };
+        match (applied.origin != target.origin, applied.size != target.size) {
+            (false, false) => None,
+            (true, false) => Some(FrameChange::Position),
+            (false, true) => Some(FrameChange::Size),
+            (true, true) => Some(FrameChange::Both),
+        }
+    }
+}
 
 /// A trait that abstracts the underlying platform's windowing system.
 ///
@@ -16,12 +45,81 @@ use anyhow::Result;
 #[async_trait]
 pub trait WindowManagerBackend {
     /// Subscribe to system events (creation, destruction, focus)
-    async fn subscribe(&self, event_sender: Sender<SystemEvent>);
+    async fn subscribe(&self, event_sender: EventSender);
 
     /// Move and resize a window to specific coordinates
     fn set_window_rect(&self, window: WindowId, rect: Rect) -> Result<()>;
 
+    /// Apply only the parts of `rect` described by `change`.
+    /// Backends where moving and resizing are separate calls should skip the unchanged one.
+    fn set_window_frame(&self, window: WindowId, rect: Rect, change: FrameChange) -> Result<()> {
+        let _ = change;
+        self.set_window_rect(window, rect)
+    }
+
+    /// Apply a whole layout pass at once, returning the windows that could not be updated.
+    /// Backends may reorder or parallelize the updates; the default applies them one by one.
+    fn apply_frames(&self, frames: &[(WindowId, Rect, FrameChange)]) -> Vec<WindowId> {
+        frames
+            .iter()
+            .filter_map(|&(window, rect, change)| match self.set_window_frame(window, rect, change) {
+                Ok(()) => None,
+                Err(e) => {
+                    log::error!("Failed to set window rect for {:?}: {}", window, e);
+                    Some(window)
+                }
+            })
+            .collect()
+    }
+
+    /// List the connected displays and their tiling areas, primary display first.
+    /// Only called at startup and after a display configuration change.
+    fn monitors(&self) -> Vec<(MonitorId, Rect)> {
+        vec![(MonitorId(0), Rect::new(Point::new(0, 0), Size::new(1920, 1080)))]
+    }
+
+    /// Get a window's current frame, used to place new windows on the display they opened on.
+    fn get_window_rect(&self, window: WindowId) -> Option<Rect> {
+        let _ = window;
+        None
+    }
+
+    /// Get the frame a window had when it appeared, used to place it on the display it opened
+    /// on. Called on the manager's loop, so backends where reading a frame messages the owning
+    /// application should answer from a cache filled when the window appeared.
+    fn opening_rect(&self, window: WindowId) -> Option<Rect> {
+        self.get_window_rect(window)
+    }
+
+    /// Bring a window to the front of its tile, e.g. after cycling a stack.
+    fn raise_window(&self, window: WindowId) -> Result<()> {
+        let _ = window;
+        Ok(())
+    }
+
+    /// Get a window's title. Called for every window on each UI update, so backends where
+    /// reading it is a round trip into the owning application should answer from a cache.
+    fn window_title(&self, window: WindowId) -> Option<String> {
+        let _ = window;
+        None
+    }
+
+    /// Get the PID of the process owning a window, used to recognize it after a restart.
+    fn window_pid(&self, window: WindowId) -> Option<i32> {
+        let _ = window;
+        None
+    }
+
+    /// Replace the window rules. Takes effect for windows that appear afterwards;
+    /// must be called before `subscribe` so windows found at startup are covered.
+    fn set_rules(&self, rules: Arc<RuleSet>);
+
+    /// Get the action of the rule matching a window, if any. Rules are evaluated once,
+    /// when the window appears, and the result is cached with the window's metadata.
+    fn window_rule(&self, window: WindowId) -> Option<RuleAction>;
+
     /// Check if a window should be managed (is it a normal app window?)
+    /// Only consulted for windows no rule matched.
     fn is_manageable(&self, window: WindowId) -> bool;
 
     /// Get the current focused window.
@@ -34,5 +132,7 @@ pub trait WindowManagerBackend {
 
 /// Windows-specific backend implementation.
 pub mod windows;
+/// Headless backend for replaying recordings and benchmarking.
+pub mod mock;
 /// macOS-specific backend implementation.
 pub mod macos;
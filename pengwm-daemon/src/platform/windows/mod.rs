@@ -2,100 +2,381 @@
 //! Uses Win32 APIs (User32) to observe and control windows.
 
 use async_trait::async_trait;
-use crate::platform::WindowManagerBackend;
+use crate::platform::{WindowManagerBackend, FrameChange};
 use crate::core::geometry::Rect;
-use crate::core::types::{WindowId, SystemEvent};
-use tokio::sync::mpsc::Sender;
+use crate::core::types::{MonitorId, WindowId, SystemEvent};
+use crate::core::queue::EventSender;
+#[cfg(target_os = "windows")]
+use crate::core::metrics::metrics;
+use crate::config::rules::{RuleAction, RuleSet, RuleSubject};
 use anyhow::Result;
+use std::collections::HashMap;
+use std::sync::{Arc, Mutex, RwLock};
+
+#[cfg(target_os = "windows")]
+use crate::core::geometry::{Point, Size};
 
 #[cfg(target_os = "windows")]
-use std::thread;
+use std::{cell::RefCell, collections::HashSet, ffi::c_void, thread};
 
 #[cfg(target_os = "windows")]
 use windows::Win32::{
-    Foundation::{HWND, RECT},
+    Foundation::{BOOL, HWND, HMODULE, HINSTANCE, LPARAM, LRESULT, RECT, WPARAM, CloseHandle},
+    Graphics::Dwm::{DwmGetWindowAttribute, DWMWA_CLOAKED},
+    System::Threading::{OpenProcess, QueryFullProcessImageNameW, PROCESS_NAME_WIN32, PROCESS_QUERY_LIMITED_INFORMATION},
+    Graphics::Gdi::{EnumDisplayMonitors, GetMonitorInfoW, HDC, HMONITOR, MONITORINFO, MONITORINFOF_PRIMARY},
+    System::LibraryLoader::GetModuleHandleW,
+    UI::Accessibility::{SetWinEventHook, HWINEVENTHOOK},
     UI::WindowsAndMessaging::{
         GetMessageW, DispatchMessageW, TranslateMessage, MSG, SetWindowPos, 
-        SWP_NOZORDER, SWP_NOACTIVATE, GetWindowLongW, GWL_STYLE, WS_VISIBLE, 
-        GWL_EXSTYLE, WS_EX_TOOLWINDOW, GetWindowTextW, GetWindowRect
+        SWP_NOZORDER, SWP_NOACTIVATE, SWP_NOMOVE, SWP_NOSIZE, HWND_TOP, GetWindowLongW, GWL_STYLE, WS_VISIBLE, 
+        GWL_EXSTYLE, WS_EX_TOOLWINDOW, GetWindowTextW, GetWindowRect, GetWindowThreadProcessId,
+        WS_CHILD, WS_EX_NOACTIVATE, GetWindow, GW_OWNER, GetWindowTextLengthW, GetAncestor, GA_ROOT,
+        IsWindowVisible, EnumWindows, OBJID_WINDOW, CHILDID_SELF, WINEVENT_OUTOFCONTEXT, WINEVENT_SKIPOWNPROCESS,
+        EVENT_OBJECT_CREATE, EVENT_OBJECT_DESTROY, EVENT_OBJECT_SHOW, EVENT_OBJECT_FOCUS,
+        EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_NAMECHANGE, EVENT_SYSTEM_FOREGROUND,
+        BeginDeferWindowPos, DeferWindowPos, EndDeferWindowPos, IsHungAppWindow, SET_WINDOW_POS_FLAGS,
+        SWP_ASYNCWINDOWPOS, CreateWindowExW, DefWindowProcW, RegisterClassW, WNDCLASSW, WINDOW_EX_STYLE,
+        WS_POPUP, HMENU, WM_DISPLAYCHANGE, WM_SETTINGCHANGE, SPI_SETWORKAREA,
     },
+    core::{w, PWSTR},
 };
 
+/// What the rules and the manager read about a window.
+#[derive(Debug, Clone, Default)]
+struct WindowIdentity {
+    /// The window title.
+    title: Option<String>,
+    /// The action of the rule that matched the window when it appeared.
+    rule: Option<RuleAction>,
+}
+
+/// Identity of every known window, read on the hook thread when the window appears and kept
+/// until it is destroyed, so the manager never opens the owning process.
+#[derive(Default)]
+struct IdentityCache {
+    windows: Mutex<HashMap<WindowId, WindowIdentity>>,
+    /// Evaluated against each window as its identity is loaded.
+    rules: RwLock<Arc<RuleSet>>,
+}
+
+impl IdentityCache {
+    /// Returns the cached identity, reading it from the window on a miss.
+    fn get_or_load(&self, window: WindowId) -> WindowIdentity {
+        if let Some(identity) = self.windows.lock().unwrap().get(&window) {
+            return identity.clone();
+        }
+        self.load(window)
+    }
+
+    /// Reads the executable name and title, evaluates the rules against them and caches the result.
+    fn load(&self, window: WindowId) -> WindowIdentity {
+        let title = read_title(window);
+        let rules = self.rules.read().unwrap().clone();
+        // The executable name is only needed by the rules, and reading it opens the process.
+        let app = if rules.is_empty() { None } else { process_name(window) };
+        let rule = rules.evaluate(RuleSubject { bundle_id: None, app: app.as_deref(), title: title.as_deref() });
+        if let Some(action) = rule {
+            log::debug!("Rule {:?} matched {:?} ({:?})", action, window, app);
+        }
+        let identity = WindowIdentity { title, rule };
+        self.windows.lock().unwrap().insert(window, identity.clone());
+        identity
+    }
+
+    /// Re-reads the title of a cached window.
+    #[cfg(target_os = "windows")]
+    fn refresh_title(&self, window: WindowId) {
+        if let Some(identity) = self.windows.lock().unwrap().get_mut(&window) {
+            identity.title = read_title(window);
+        }
+    }
+
+    /// Returns the cached title of a window, or `None` if the window is not cached.
+    fn title(&self, window: WindowId) -> Option<Option<String>> {
+        self.windows.lock().unwrap().get(&window).map(|identity| identity.title.clone())
+    }
+
+    /// Forgets a window.
+    fn remove(&self, window: WindowId) {
+        self.windows.lock().unwrap().remove(&window);
+    }
+}
+
 /// Windows-specific window manager backend.
-pub struct WindowsBackend;
+#[derive(Default)]
+pub struct WindowsBackend {
+    /// Executable names, titles and rule results of known windows, shared with the hook thread.
+    identities: Arc<IdentityCache>,
+}
+
+impl WindowsBackend {
+    /// Creates the backend with no window rules.
+    pub fn new() -> Self {
+        Self::default()
+    }
+}
 
 #[async_trait]
 impl WindowManagerBackend for WindowsBackend {
-    /// Subscribes to window system events (stub implementation).
-    async fn subscribe(&self, _event_sender: Sender<SystemEvent>) {
+    /// Reports existing windows, then installs out-of-context WinEvent hooks and a hidden
+    /// display listener window on a dedicated thread. Hook callbacks run on that thread's
+    /// message loop and filter events there, so only top-level windows cross into the event queue.
+    async fn subscribe(&self, event_sender: EventSender) {
         #[cfg(target_os = "windows")]
-        thread::spawn(move || {
-            log::info!("Windows event hook started (stub)");
-            let mut msg = MSG::default();
-            unsafe {
-                // Main Win32 message loop to receive system-wide window events.
-                while GetMessageW(&mut msg, HWND(0), 0, 0).as_bool() {
-                    TranslateMessage(&msg);
-                    DispatchMessageW(&msg);
+        let identities = self.identities.clone();
+        #[cfg(target_os = "windows")]
+        thread::spawn(move || unsafe {
+            HOOK_STATE.with(|state| {
+                *state.borrow_mut() = Some(HookState {
+                    sender: event_sender,
+                    known: HashSet::new(),
+                    focused: HWND(0),
+                    identities,
+                });
+            });
+            discover_existing_windows();
+
+            // Separate ranges, so unrelated events in between (hide, reorder, selection, ...)
+            // are never delivered at all.
+            let ranges = [
+                (EVENT_OBJECT_CREATE, EVENT_OBJECT_SHOW),
+                (EVENT_OBJECT_FOCUS, EVENT_OBJECT_FOCUS),
+                (EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_NAMECHANGE),
+                (EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND),
+            ];
+            for (min, max) in ranges {
+                let hook = SetWinEventHook(
+                    min,
+                    max,
+                    HMODULE(0),
+                    Some(win_event_callback),
+                    0,
+                    0,
+                    WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS,
+                );
+                if hook.is_invalid() {
+                    log::error!("SetWinEventHook failed for events {:#x}..={:#x}", min, max);
                 }
             }
+            log::info!("Windows event hooks installed");
+            create_display_listener();
+
+            // Out-of-context hooks and the listener's messages are delivered through this
+            // thread's message loop.
+            let mut msg = MSG::default();
+            while GetMessageW(&mut msg, HWND(0), 0, 0).as_bool() {
+                TranslateMessage(&msg);
+                DispatchMessageW(&msg);
+            }
         });
+        #[cfg(not(target_os = "windows"))]
+        let _ = event_sender;
     }
 
     /// Moves and resizes a window to the specified rectangle using `SetWindowPos`.
     fn set_window_rect(&self, window: WindowId, rect: Rect) -> Result<()> {
+        self.set_window_frame(window, rect, FrameChange::Both)
+    }
+
+    /// Calls `SetWindowPos` with `SWP_NOMOVE`/`SWP_NOSIZE` for the parts that did not change.
+    /// Windows of hung applications are moved asynchronously so the call cannot block.
+    fn set_window_frame(&self, window: WindowId, rect: Rect, change: FrameChange) -> Result<()> {
+        log::trace!("Windows: Moving window {:?} to {:?}", window, rect);
         #[cfg(target_os = "windows")]
         unsafe {
-            let hwnd = HWND(window.0 as isize);
-            let _ = SetWindowPos(
+            let hwnd = hwnd_of(window);
+            let mut flags = frame_flags(change);
+            if IsHungAppWindow(hwnd).as_bool() {
+                flags |= SWP_ASYNCWINDOWPOS;
+            }
+            SetWindowPos(
                 hwnd,
                 HWND(0),
                 rect.min_x(),
                 rect.min_y(),
                 rect.width() as i32,
                 rect.height() as i32,
-                SWP_NOZORDER | SWP_NOACTIVATE,
-            );
+                flags,
+            )?;
         }
-        log::info!("Windows: Moving window {:?} to {:?}", window, rect);
+        #[cfg(not(target_os = "windows"))]
+        let _ = change;
         Ok(())
     }
 
+    /// Moves every window of a layout pass in one `DeferWindowPos` transaction, so DWM
+    /// recomposites once instead of once per window.
+    ///
+    /// A failed `DeferWindowPos` invalidates the whole transaction, so the rejecting window is
+    /// set aside and the transaction rebuilt without it. Set-aside windows, and windows of
+    /// hung applications (which would stall `EndDeferWindowPos`), are moved one by one.
+    fn apply_frames(&self, frames: &[(WindowId, Rect, FrameChange)]) -> Vec<WindowId> {
+        #[cfg(target_os = "windows")]
+        unsafe {
+            let (mut deferred, mut single): (Vec<_>, Vec<_>) = frames
+                .iter()
+                .partition(|&&(window, _, _)| !IsHungAppWindow(hwnd_of(window)).as_bool());
+            while deferred.len() > 1 {
+                let _span = tracing::debug_span!("set_frames", windows = deferred.len()).entered();
+                match defer_frames(&deferred) {
+                    Ok(()) => {
+                        log::debug!("Windows: Moved {} window(s) in one transaction", deferred.len());
+                        deferred.clear();
+                    }
+                    Err(DeferError::Rejected(index)) => single.push(deferred.remove(index)),
+                    Err(DeferError::Commit) => break,
+                }
+            }
+            // Whatever is left could not be committed together. Each call is timed against
+            // the owning application, like the per-window calls of the macOS backend.
+            single.extend(deferred);
+            single
+                .into_iter()
+                .filter_map(|&(window, rect, change)| {
+                    let pid = window_pid(window) as i32;
+                    let _span = tracing::debug_span!("set_frame", pid, ?window).entered();
+                    let started = std::time::Instant::now();
+                    let result = self.set_window_frame(window, rect, change);
+                    metrics().app(pid).record_duration(started.elapsed());
+                    match result {
+                        Ok(()) => None,
+                        Err(e) => {
+                            log::error!("Failed to set window rect for {:?}: {}", window, e);
+                            Some(window)
+                        }
+                    }
+                })
+                .collect()
+        }
+        #[cfg(not(target_os = "windows"))]
+        frames
+            .iter()
+            .filter_map(|&(window, rect, change)| self.set_window_frame(window, rect, change).err().map(|_| window))
+            .collect()
+    }
+
+    /// Moves the window to the top of the Z order without activating it.
+    fn raise_window(&self, window: WindowId) -> Result<()> {
+        #[cfg(target_os = "windows")]
+        unsafe {
+            SetWindowPos(
+                hwnd_of(window),
+                HWND_TOP,
+                0,
+                0,
+                0,
+                0,
+                SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE,
+            )?;
+        }
+        #[cfg(not(target_os = "windows"))]
+        let _ = window;
+        Ok(())
+    }
+
+    /// Answered from the identity cache, which the hook thread refreshes before reporting a
+    /// title change; unknown windows are read directly.
+    fn window_title(&self, window: WindowId) -> Option<String> {
+        self.identities.title(window).unwrap_or_else(|| read_title(window))
+    }
+
+    /// Reads the owning process with `GetWindowThreadProcessId`.
+    fn window_pid(&self, window: WindowId) -> Option<i32> {
+        #[cfg(target_os = "windows")]
+        {
+            let pid = window_pid(window);
+            (pid != 0).then_some(pid as i32)
+        }
+        #[cfg(not(target_os = "windows"))]
+        {
+            let _ = window;
+            None
+        }
+    }
+
+    /// Lists displays via `EnumDisplayMonitors`, using each one's work area (excluding the
+    /// taskbar), with the primary display first.
+    fn monitors(&self) -> Vec<(MonitorId, Rect)> {
+        #[cfg(target_os = "windows")]
+        unsafe {
+            let mut found: Vec<(MonitorId, Rect, bool)> = Vec::new();
+            let _ = EnumDisplayMonitors(
+                HDC(0),
+                None,
+                Some(collect_monitor),
+                LPARAM(&mut found as *mut _ as isize),
+            );
+            found.sort_by_key(|&(_, _, primary)| !primary);
+            found.into_iter().map(|(id, rect, _)| (id, rect)).collect()
+        }
+        #[cfg(not(target_os = "windows"))]
+        Vec::new()
+    }
+
+    /// Reads the window's frame with `GetWindowRect`.
+    fn get_window_rect(&self, window: WindowId) -> Option<Rect> {
+        #[cfg(target_os = "windows")]
+        unsafe {
+            let mut rect = RECT::default();
+            GetWindowRect(hwnd_of(window), &mut rect).ok()?;
+            Some(to_rect(rect))
+        }
+        #[cfg(not(target_os = "windows"))]
+        {
+            let _ = window;
+            None
+        }
+    }
+
+    /// Swaps in the new rules. Windows already known keep the result of the rules they
+    /// were evaluated against.
+    fn set_rules(&self, rules: Arc<RuleSet>) {
+        *self.identities.rules.write().unwrap() = rules;
+    }
+
+    /// Returns the rule result cached when the window appeared, evaluated against the
+    /// executable name and title; there is no bundle id on Windows.
+    fn window_rule(&self, window: WindowId) -> Option<RuleAction> {
+        self.identities.get_or_load(window).rule
+    }
+
     /// Determines if a window should be managed by the window manager.
-    /// Filters out tooltips, popups, and other non-standard windows based on styles.
+    /// Filters out tooltips, popups, and other non-standard windows, cheapest checks first;
+    /// none of them message the window's thread.
     fn is_manageable(&self, window: WindowId) -> bool {
         #[cfg(target_os = "windows")]
         unsafe {
-            let hwnd = HWND(window.0 as isize);
-            
-            // 1. Must be visible
-            let style = GetWindowLongW(hwnd, GWL_STYLE);
-            if (style as u32 & WS_VISIBLE.0) == 0 {
+            let hwnd = hwnd_of(window);
+
+            // 1. Must be a visible top-level window and not a tool window.
+            if !is_top_level_candidate(hwnd) {
                 return false;
             }
-
-            // 2. Must not be a tool window
-            let ex_style = GetWindowLongW(hwnd, GWL_EXSTYLE);
-            if (ex_style as u32 & WS_EX_TOOLWINDOW.0) != 0 {
+            let ex_style = GetWindowLongW(hwnd, GWL_EXSTYLE) as u32;
+            if ex_style & WS_EX_NOACTIVATE.0 != 0 {
                 return false;
             }
 
-            // 3. Must have a title (simple heuristic)
-            let mut title = [0u16; 256];
-            let len = GetWindowTextW(hwnd, &mut title);
-            if len == 0 {
+            // 2. Must not be owned: owned windows are dialogs and popups of another window.
+            if GetWindow(hwnd, GW_OWNER).0 != 0 {
                 return false;
             }
 
-            // 4. Must not be tiny (e.g. 0x0)
-            let mut rect = RECT::default();
-            if GetWindowRect(hwnd, &mut rect).is_ok() {
-                if rect.right - rect.left < 50 || rect.bottom - rect.top < 50 {
-                    return false;
-                }
+            // 3. Must have a title; only its length is needed.
+            if GetWindowTextLengthW(hwnd) == 0 {
+                return false;
             }
 
-            true
+            // 4. Must not be cloaked (suspended UWP apps, other virtual desktops).
+            let mut cloaked = 0u32;
+            let read = DwmGetWindowAttribute(
+                hwnd,
+                DWMWA_CLOAKED,
+                &mut cloaked as *mut u32 as *mut c_void,
+                std::mem::size_of::<u32>() as u32,
+            );
+            read.is_err() || cloaked == 0
         }
         #[cfg(not(target_os = "windows"))]
         {
@@ -109,8 +390,313 @@ impl WindowManagerBackend for WindowsBackend {
         Ok(WindowId(0))
     }
 
-    /// No-op on Windows.
-    fn release_window(&self, _window: WindowId) {
-        // Windows HWNDs don't need explicit releasing like AXUIElementRef.
+    /// Forgets the window's identity. HWNDs don't need explicit releasing like AXUIElementRef.
+    fn release_window(&self, window: WindowId) {
+        self.identities.remove(window);
+    }
+}
+
+/// Returns the window handle behind an id. Window handles only have 32 significant bits
+/// and are sign-extended to pointer size.
+#[cfg(target_os = "windows")]
+fn hwnd_of(window: WindowId) -> HWND {
+    HWND(window.0 as i32 as isize)
+}
+
+/// Returns the id of a window handle; see `hwnd_of`.
+#[cfg(target_os = "windows")]
+fn window_id(hwnd: HWND) -> WindowId {
+    WindowId(hwnd.0 as u32)
+}
+
+/// `SetWindowPos` flags applying only the parts of a frame described by `change`.
+#[cfg(target_os = "windows")]
+fn frame_flags(change: FrameChange) -> SET_WINDOW_POS_FLAGS {
+    let flags = SWP_NOZORDER | SWP_NOACTIVATE;
+    match change {
+        FrameChange::Position => flags | SWP_NOSIZE,
+        FrameChange::Size => flags | SWP_NOMOVE,
+        FrameChange::Both => flags,
     }
 }
+
+/// Why a `DeferWindowPos` transaction was not committed.
+#[cfg(target_os = "windows")]
+enum DeferError {
+    /// The frame at this index was rejected; the transaction was discarded.
+    Rejected(usize),
+    /// `BeginDeferWindowPos` or `EndDeferWindowPos` failed.
+    Commit,
+}
+
+/// Moves all `frames` in a single `DeferWindowPos` transaction.
+#[cfg(target_os = "windows")]
+unsafe fn defer_frames(frames: &[&(WindowId, Rect, FrameChange)]) -> std::result::Result<(), DeferError> {
+    let mut hdwp = BeginDeferWindowPos(frames.len() as i32).map_err(|_| DeferError::Commit)?;
+    for (index, &&(window, rect, change)) in frames.iter().enumerate() {
+        log::trace!("Windows: Moving window {:?} to {:?} (deferred)", window, rect);
+        hdwp = DeferWindowPos(
+            hdwp,
+            hwnd_of(window),
+            HWND(0),
+            rect.min_x(),
+            rect.min_y(),
+            rect.width() as i32,
+            rect.height() as i32,
+            frame_flags(change),
+        )
+        .map_err(|_| DeferError::Rejected(index))?;
+    }
+    EndDeferWindowPos(hdwp).map_err(|_| DeferError::Commit)
+}
+
+/// State of the hook thread, reached from the WinEvent callback, which has no user data.
+#[cfg(target_os = "windows")]
+struct HookState {
+    /// Queue into the Window Manager.
+    sender: EventSender,
+    /// Top-level windows reported as created and not yet destroyed.
+    known: HashSet<isize>,
+    /// The window most recently reported as focused, to drop repeated focus events.
+    focused: HWND,
+    /// Identities of known windows, loaded as they appear.
+    identities: Arc<IdentityCache>,
+}
+
+#[cfg(target_os = "windows")]
+thread_local! {
+    /// Set up by `subscribe` on the hook thread before the hooks are installed.
+    static HOOK_STATE: RefCell<Option<HookState>> = RefCell::new(None);
+}
+
+/// Cheap pre-filter shared by the hook and `is_manageable`: a visible top-level window that
+/// is neither a child nor a tool window. Only reads state kept by the window manager itself.
+#[cfg(target_os = "windows")]
+unsafe fn is_top_level_candidate(hwnd: HWND) -> bool {
+    let style = GetWindowLongW(hwnd, GWL_STYLE) as u32;
+    if style & WS_VISIBLE.0 == 0 || style & WS_CHILD.0 != 0 {
+        return false;
+    }
+    let ex_style = GetWindowLongW(hwnd, GWL_EXSTYLE) as u32;
+    ex_style & WS_EX_TOOLWINDOW.0 == 0 && IsWindowVisible(hwnd).as_bool() && GetAncestor(hwnd, GA_ROOT) == hwnd
+}
+
+/// Reports the windows that already exist, as a single batch.
+#[cfg(target_os = "windows")]
+unsafe fn discover_existing_windows() {
+    let mut windows: Vec<HWND> = Vec::new();
+    let _ = EnumWindows(Some(collect_window), LPARAM(&mut windows as *mut _ as isize));
+    HOOK_STATE.with(|state| {
+        let mut state = state.borrow_mut();
+        let Some(state) = state.as_mut() else {
+            return;
+        };
+        let windows: Vec<WindowId> = windows
+            .into_iter()
+            .filter(|&hwnd| is_top_level_candidate(hwnd))
+            .inspect(|&hwnd| {
+                state.known.insert(hwnd.0);
+                state.identities.load(window_id(hwnd));
+            })
+            .map(window_id)
+            .collect();
+        log::info!("Discovered {} window(s)", windows.len());
+        state.sender.send(SystemEvent::WindowsDiscovered(windows));
+    });
+}
+
+/// `EnumWindows` callback that appends each top-level window to the `Vec` passed through `data`.
+#[cfg(target_os = "windows")]
+unsafe extern "system" fn collect_window(hwnd: HWND, data: LPARAM) -> BOOL {
+    (*(data.0 as *mut Vec<HWND>)).push(hwnd);
+    BOOL(1)
+}
+
+/// WinEvent callback. Drops events about anything other than top-level windows before they
+/// reach the queue: controls, carets, cursors, menus and windows we never reported.
+#[cfg(target_os = "windows")]
+unsafe extern "system" fn win_event_callback(
+    _hook: HWINEVENTHOOK,
+    event: u32,
+    hwnd: HWND,
+    object: i32,
+    child: i32,
+    _thread: u32,
+    _time: u32,
+) {
+    if hwnd.0 == 0 {
+        return;
+    }
+    HOOK_STATE.with(|state| {
+        let mut state = state.borrow_mut();
+        let Some(state) = state.as_mut() else {
+            return;
+        };
+        let window = window_id(hwnd);
+        let event = match event {
+            EVENT_OBJECT_FOCUS | EVENT_SYSTEM_FOREGROUND => {
+                // Focus usually lands on a control; report the top-level window holding it, once.
+                let root = GetAncestor(hwnd, GA_ROOT);
+                if root == state.focused || !state.known.contains(&root.0) {
+                    return;
+                }
+                state.focused = root;
+                SystemEvent::WindowFocused(window_id(root))
+            }
+            _ if object != OBJID_WINDOW.0 || child != CHILDID_SELF as i32 => return,
+            EVENT_OBJECT_CREATE | EVENT_OBJECT_SHOW => {
+                // Windows are often created hidden; those are reported when first shown.
+                if state.known.contains(&hwnd.0) || !is_top_level_candidate(hwnd) {
+                    return;
+                }
+                state.known.insert(hwnd.0);
+                state.identities.load(window);
+                SystemEvent::WindowCreated(window)
+            }
+            EVENT_OBJECT_DESTROY => {
+                if !state.known.remove(&hwnd.0) {
+                    return;
+                }
+                if state.focused == hwnd {
+                    state.focused = HWND(0);
+                }
+                state.identities.remove(window);
+                SystemEvent::WindowDestroyed(window)
+            }
+            EVENT_OBJECT_LOCATIONCHANGE if state.known.contains(&hwnd.0) => SystemEvent::WindowMoved(window),
+            EVENT_OBJECT_NAMECHANGE if state.known.contains(&hwnd.0) => {
+                state.identities.refresh_title(window);
+                SystemEvent::WindowTitleChanged(window)
+            }
+            _ => return,
+        };
+        state.sender.send(event);
+    });
+}
+
+/// Creates a hidden top-level window on the hook thread, which receives the broadcasts sent
+/// when displays change. Message-only windows do not receive broadcasts.
+#[cfg(target_os = "windows")]
+unsafe fn create_display_listener() {
+    let class_name = w!("PengwmDisplayListener");
+    let instance = GetModuleHandleW(None).map(|module| HINSTANCE(module.0)).unwrap_or_default();
+    let class = WNDCLASSW {
+        lpfnWndProc: Some(display_listener_proc),
+        hInstance: instance,
+        lpszClassName: class_name,
+        ..Default::default()
+    };
+    if RegisterClassW(&class) == 0 {
+        log::error!("Failed to register the display listener window class");
+        return;
+    }
+    let window = CreateWindowExW(
+        WINDOW_EX_STYLE(0),
+        class_name,
+        w!(""),
+        WS_POPUP,
+        0,
+        0,
+        0,
+        0,
+        HWND(0),
+        HMENU(0),
+        instance,
+        None,
+    );
+    if window.0 == 0 {
+        log::error!("Failed to create the display listener window; display changes are not tracked");
+    }
+}
+
+/// Window procedure of the display listener. Reports resolution, arrangement and work area
+/// changes; the broadcasts do not name a display, so the event carries id 0 and the manager
+/// re-reads them all, once per batch.
+#[cfg(target_os = "windows")]
+unsafe extern "system" fn display_listener_proc(window: HWND, message: u32, wparam: WPARAM, lparam: LPARAM) -> LRESULT {
+    let changed = message == WM_DISPLAYCHANGE
+        || (message == WM_SETTINGCHANGE && wparam.0 as u32 == SPI_SETWORKAREA.0);
+    if changed {
+        HOOK_STATE.with(|state| {
+            // WinEvent callbacks never pump messages while holding the state, but never panic here.
+            if let Some(state) = state.try_borrow().ok().as_ref().and_then(|state| state.as_ref()) {
+                state.sender.send(SystemEvent::MonitorChanged(MonitorId(0)));
+            }
+        });
+    }
+    DefWindowProcW(window, message, wparam, lparam)
+}
+
+/// `EnumDisplayMonitors` callback that appends each display's ID, work area and primary flag
+/// to the `Vec` passed through `data`.
+#[cfg(target_os = "windows")]
+unsafe extern "system" fn collect_monitor(monitor: HMONITOR, _hdc: HDC, _clip: *mut RECT, data: LPARAM) -> BOOL {
+    let found = &mut *(data.0 as *mut Vec<(MonitorId, Rect, bool)>);
+    let mut info = MONITORINFO {
+        cbSize: std::mem::size_of::<MONITORINFO>() as u32,
+        ..Default::default()
+    };
+    if GetMonitorInfoW(monitor, &mut info).as_bool() {
+        let primary = info.dwFlags & MONITORINFOF_PRIMARY != 0;
+        found.push((MonitorId(monitor.0 as usize), to_rect(info.rcWork), primary));
+    }
+    BOOL(1)
+}
+
+/// Converts a Win32 `RECT` into a layout rectangle.
+#[cfg(target_os = "windows")]
+fn to_rect(rect: RECT) -> Rect {
+    Rect::new(
+        Point::new(rect.left, rect.top),
+        Size::new(rect.right - rect.left, rect.bottom - rect.top),
+    )
+}
+
+/// Returns the ID of the process owning a window, or 0 if the window is gone.
+#[cfg(target_os = "windows")]
+fn window_pid(window: WindowId) -> u32 {
+    let mut pid = 0u32;
+    unsafe { GetWindowThreadProcessId(hwnd_of(window), Some(&mut pid)) };
+    pid
+}
+
+/// Reads the title with `GetWindowTextW`, which for other processes' windows returns the
+/// caption stored by the system without messaging the owning thread.
+#[cfg(target_os = "windows")]
+fn read_title(window: WindowId) -> Option<String> {
+    unsafe {
+        let mut title = [0u16; 256];
+        let len = GetWindowTextW(hwnd_of(window), &mut title);
+        (len > 0).then(|| String::from_utf16_lossy(&title[..len as usize]))
+    }
+}
+
+/// Reads the title of a window.
+#[cfg(not(target_os = "windows"))]
+fn read_title(window: WindowId) -> Option<String> {
+    let _ = window;
+    None
+}
+
+/// Returns the executable name, without extension, of the process owning a window.
+#[cfg(target_os = "windows")]
+fn process_name(window: WindowId) -> Option<String> {
+    unsafe {
+        let pid = window_pid(window);
+        let process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, pid).ok()?;
+        let mut path = [0u16; 260];
+        let mut len = path.len() as u32;
+        let result = QueryFullProcessImageNameW(process, PROCESS_NAME_WIN32, PWSTR(path.as_mut_ptr()), &mut len);
+        let _ = CloseHandle(process);
+        result.ok()?;
+        let path = String::from_utf16_lossy(&path[..len as usize]);
+        std::path::Path::new(&path).file_stem().map(|stem| stem.to_string_lossy().into_owned())
+    }
+}
+
+/// Returns the executable name of the process owning a window.
+#[cfg(not(target_os = "windows"))]
+fn process_name(window: WindowId) -> Option<String> {
+    let _ = window;
+    None
+}
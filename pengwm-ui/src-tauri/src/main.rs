@@ -1,31 +1,243 @@
 // Prevents additional console window on Windows in release, DO NOT REMOVE!!
 #![cfg_attr(not(debug_assertions), windows_subsystem = "windows")]
 
-use interprocess::local_socket::LocalSocketStream;
-use std::io::{BufRead, BufReader};
-use tauri::Emitter;
+use futures::io::{AsyncBufReadExt, BufReader};
+use interprocess::local_socket::tokio::LocalSocketStream;
+use std::collections::{HashMap, HashSet};
+use std::time::Duration;
+use tauri::{AppHandle, Emitter};
 use serde::{Serialize, Deserialize};
+use tokio::sync::mpsc;
+use tokio::time::Instant;
+
+/// Shortest time between two updates sent to the webview: one refresh of a 60 Hz display.
+/// Events arriving in between are folded into the next update.
+const FRAME_INTERVAL: Duration = Duration::from_micros(16_667);
 
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct UiState {
+    #[serde(default)]
+    pub seq: u64,
     pub windows: Vec<WindowInfo>,
-    pub focused_window: Option<usize>,
+    pub focused_window: Option<u32>,
+    #[serde(default)]
+    pub stats: TreeStats,
+}
+
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct StateDelta {
+    pub seq: u64,
+    pub added: Vec<WindowInfo>,
+    pub moved: Vec<WindowInfo>,
+    pub removed: Vec<u32>,
+    pub focused_window: Option<u32>,
+    pub stats: TreeStats,
+}
+
+#[derive(Debug, Clone, Default, Serialize, Deserialize)]
+pub struct TreeStats {
+    pub leaves: usize,
+    pub windows: usize,
+    pub stacked: usize,
+    pub depth: usize,
+    #[serde(default)]
+    pub arena_nodes: usize,
+    #[serde(default)]
+    pub live_nodes: usize,
 }
 
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct WindowInfo {
-    pub id: usize,
+    pub id: u32,
     pub title: String,
     pub x: i32,
     pub y: i32,
     pub width: u32,
     pub height: u32,
+    #[serde(default)]
+    pub stacked: usize,
+    #[serde(default)]
+    pub monitor: usize,
+    #[serde(default)]
+    pub workspace: usize,
 }
 
 #[derive(Debug, Clone, Serialize, Deserialize)]
 #[serde(tag = "type", content = "data")]
 pub enum UiEvent {
     StateChanged(UiState),
+    StateDelta(StateDelta),
+    FocusChanged { seq: u64, focused_window: Option<u32> },
+}
+
+impl UiEvent {
+    /// Sequence number of the state this event leaves the client in.
+    fn seq(&self) -> u64 {
+        match self {
+            UiEvent::StateChanged(state) => state.seq,
+            UiEvent::StateDelta(delta) => delta.seq,
+            UiEvent::FocusChanged { seq, .. } => *seq,
+        }
+    }
+}
+
+/// Changes to send to the webview, folded from every event received since the last update.
+#[derive(Debug)]
+enum Pending {
+    /// A new connection's snapshot, with the events that followed it applied.
+    Snapshot(UiState),
+    /// Changes on top of the previous update. A window is either upserted or removed.
+    Delta {
+        seq: u64,
+        upserted: HashMap<u32, WindowInfo>,
+        removed: HashSet<u32>,
+        focused_window: Option<u32>,
+        stats: Option<TreeStats>,
+    },
+}
+
+impl Pending {
+    /// Starts an update with the first event received since the last one.
+    fn new(event: UiEvent) -> Self {
+        match event {
+            UiEvent::StateChanged(state) => Pending::Snapshot(state),
+            event => {
+                let mut pending = Pending::Delta {
+                    seq: event.seq(),
+                    upserted: HashMap::new(),
+                    removed: HashSet::new(),
+                    focused_window: None,
+                    stats: None,
+                };
+                pending.fold(event);
+                pending
+            }
+        }
+    }
+
+    /// Folds a later event into the update.
+    fn fold(&mut self, event: UiEvent) {
+        match (self, event) {
+            (this, UiEvent::StateChanged(state)) => *this = Pending::Snapshot(state),
+            (Pending::Snapshot(state), UiEvent::StateDelta(delta)) => {
+                let removed: HashSet<u32> = delta.removed.iter().copied().collect();
+                let mut changed: HashMap<u32, WindowInfo> =
+                    delta.moved.into_iter().chain(delta.added).map(|w| (w.id, w)).collect();
+                state.windows.retain(|w| !removed.contains(&w.id));
+                for window in &mut state.windows {
+                    if let Some(update) = changed.remove(&window.id) {
+                        *window = update;
+                    }
+                }
+                state.windows.extend(changed.into_values());
+                state.seq = delta.seq;
+                state.focused_window = delta.focused_window;
+                state.stats = delta.stats;
+            }
+            (Pending::Snapshot(state), UiEvent::FocusChanged { seq, focused_window }) => {
+                state.seq = seq;
+                state.focused_window = focused_window;
+            }
+            (Pending::Delta { seq, upserted, removed, focused_window, stats }, UiEvent::StateDelta(delta)) => {
+                for id in delta.removed {
+                    upserted.remove(&id);
+                    removed.insert(id);
+                }
+                for window in delta.moved.into_iter().chain(delta.added) {
+                    removed.remove(&window.id);
+                    upserted.insert(window.id, window);
+                }
+                *seq = delta.seq;
+                *focused_window = delta.focused_window;
+                *stats = Some(delta.stats);
+            }
+            (Pending::Delta { seq, focused_window, .. }, UiEvent::FocusChanged { seq: next, focused_window: focus }) => {
+                *seq = next;
+                *focused_window = focus;
+            }
+        }
+    }
+
+    /// Converts the update into what the webview receives.
+    fn into_update(self) -> UiUpdate {
+        match self {
+            Pending::Snapshot(state) => UiUpdate::Snapshot(state),
+            Pending::Delta { seq, upserted, removed, focused_window, stats } => UiUpdate::Delta {
+                seq,
+                upserted: upserted.into_values().collect(),
+                removed: removed.into_iter().collect(),
+                focused_window,
+                stats,
+            },
+        }
+    }
+}
+
+/// One update of the webview's store, emitted as `state-changed` at most once per frame.
+#[derive(Debug, Clone, Serialize)]
+#[serde(tag = "type", content = "data")]
+enum UiUpdate {
+    /// Replaces the whole store.
+    Snapshot(UiState),
+    /// Inserts or replaces the `upserted` windows, drops the `removed` ones.
+    Delta {
+        seq: u64,
+        upserted: Vec<WindowInfo>,
+        removed: Vec<u32>,
+        focused_window: Option<u32>,
+        /// `None` if only the focus changed.
+        stats: Option<TreeStats>,
+    },
+}
+
+/// Reads the daemon's events, reconnecting whenever the connection fails or an update was
+/// missed. The daemon starts every connection with a snapshot.
+async fn read_events(pipe_name: &'static str, events: mpsc::UnboundedSender<UiEvent>) {
+    loop {
+        let stream = match LocalSocketStream::connect(pipe_name).await {
+            Ok(stream) => stream,
+            Err(_) => {
+                // Daemon might not be running yet, retry in 1s
+                tokio::time::sleep(Duration::from_secs(1)).await;
+                continue;
+            }
+        };
+        let mut reader = BufReader::new(stream);
+        let mut line = String::new();
+        let mut last_seq: Option<u64> = None;
+        while matches!(reader.read_line(&mut line).await, Ok(n) if n > 0) {
+            if let Ok(event) = serde_json::from_str::<UiEvent>(&line) {
+                // Deltas only apply on top of the previous sequence number;
+                // on a gap, reconnect to receive a fresh snapshot.
+                let is_snapshot = matches!(event, UiEvent::StateChanged(_));
+                if !is_snapshot && last_seq.map(|seq| seq + 1) != Some(event.seq()) {
+                    break;
+                }
+                last_seq = Some(event.seq());
+                if events.send(event).is_err() {
+                    return;
+                }
+            }
+            line.clear();
+        }
+    }
+}
+
+/// Emits the received events to the webview, coalescing bursts to one update per frame.
+/// The first event after a quiet period is emitted right away.
+async fn emit_updates(handle: AppHandle, mut events: mpsc::UnboundedReceiver<UiEvent>) {
+    let mut last_emit: Option<Instant> = None;
+    while let Some(event) = events.recv().await {
+        let mut pending = Pending::new(event);
+        if let Some(last_emit) = last_emit {
+            tokio::time::sleep_until(last_emit + FRAME_INTERVAL).await;
+        }
+        while let Ok(event) = events.try_recv() {
+            pending.fold(event);
+        }
+        let _ = handle.emit("state-changed", pending.into_update());
+        last_emit = Some(Instant::now());
+    }
 }
 
 #[tauri::command]
@@ -39,33 +251,17 @@ fn main() {
         .invoke_handler(tauri::generate_handler![greet])
         .setup(|app| {
             let handle = app.handle().clone();
-            
-            tauri::async_runtime::spawn(async move {
-                #[cfg(target_os = "windows")]
-                let pipe_name = "\\\\.\\pipe\\pengwm-ipc";
-                #[cfg(target_os = "macos")]
-                let pipe_name = "/tmp/pengwm.sock";
-
-                loop {
-                    match LocalSocketStream::connect(pipe_name) {
-                        Ok(stream) => {
-                            let mut reader = BufReader::new(stream);
-                            let mut line = String::new();
-                            while reader.read_line(&mut line).is_ok() {
-                                if line.is_empty() { break; }
-                                if let Ok(event) = serde_json::from_str::<UiEvent>(&line) {
-                                    let _ = handle.emit("state-changed", event);
-                                }
-                                line.clear();
-                            }
-                        }
-                        Err(_) => {
-                            // Daemon might not be running yet, retry in 1s
-                            tokio::time::sleep(std::time::Duration::from_secs(1)).await;
-                        }
-                    }
-                }
-            });
+
+            #[cfg(target_os = "windows")]
+            let pipe_name = "\\\\.\\pipe\\pengwm-ipc";
+            #[cfg(target_os = "macos")]
+            let pipe_name = "/tmp/pengwm.sock";
+
+            // The socket is read asynchronously, so no runtime thread blocks on it, and
+            // bursts reach the webview at most once per frame.
+            let (events_tx, events_rx) = mpsc::unbounded_channel();
+            tauri::async_runtime::spawn(read_events(pipe_name, events_tx));
+            tauri::async_runtime::spawn(emit_updates(handle, events_rx));
 
             Ok(())
         })
@@ -0,0 +1,124 @@
+/**
+ * The window layout mirrored from the daemon.
+ * Updates arrive from the Tauri bridge at most once per frame and are applied in place, so
+ * only the windows an update names are touched.
+ */
+import { SvelteMap } from "svelte/reactivity";
+
+/** Information about a single managed window. */
+export interface WindowInfo {
+  /** Unique identifier for the window, assigned by the daemon. */
+  id: number;
+  /** The display title of the window. */
+  title: string;
+  /** X coordinate of the window's top-left corner. */
+  x: number;
+  /** Y coordinate of the window's top-left corner. */
+  y: number;
+  /** Width of the window in pixels. */
+  width: number;
+  /** Height of the window in pixels. */
+  height: number;
+  /** Number of windows stacked behind this one in its tile. */
+  stacked: number;
+  /** The display the window is tiled on. */
+  monitor: number;
+  /** The workspace of that display the window belongs to. */
+  workspace: number;
+}
+
+/** Shape counters of the daemon's window tree. */
+export interface TreeStats {
+  /** Number of tiles (leaf nodes). */
+  leaves: number;
+  /** Total number of managed windows, visible or stacked. */
+  windows: number;
+  /** Number of windows stacked behind a visible one. */
+  stacked: number;
+  /** Length of the longest root-to-leaf path. */
+  depth: number;
+  /** Number of nodes allocated in the tree arenas, including recycled ones. */
+  arena_nodes: number;
+  /** Number of nodes currently attached to a tree. */
+  live_nodes: number;
+}
+
+/** The complete state, sent by the bridge when it (re)connects to the daemon. */
+export interface UiState {
+  /** Sequence number of the last daemon update folded into this state. */
+  seq: number;
+  /** Every window shown on a display. */
+  windows: WindowInfo[];
+  /** The ID of the currently focused window, if any. */
+  focused_window: number | null;
+  /** Shape counters of the window tree. */
+  stats: TreeStats;
+}
+
+/** Every daemon update received since the previous one, folded together by the bridge. */
+export interface UiDelta {
+  /** Sequence number of the last daemon update folded into this one. */
+  seq: number;
+  /** Windows that are new or changed, in full. */
+  upserted: WindowInfo[];
+  /** IDs of windows that are no longer shown. */
+  removed: number[];
+  /** The ID of the currently focused window, if any. */
+  focused_window: number | null;
+  /** Shape counters of the window tree; `null` if only the focus changed. */
+  stats: TreeStats | null;
+}
+
+/** Payload of the bridge's `state-changed` event. */
+export type UiUpdate =
+  | { type: "Snapshot"; data: UiState }
+  | { type: "Delta"; data: UiDelta };
+
+/** Reactive mirror of the daemon's layout. */
+export class LayoutStore {
+  /** Windows by ID; reading one window only tracks that window. */
+  windows = new SvelteMap<number, WindowInfo>();
+  /** Tree counters reported by the daemon. */
+  stats = $state<TreeStats>({ leaves: 0, windows: 0, stacked: 0, depth: 0, arena_nodes: 0, live_nodes: 0 });
+  /** The ID of the focused window, highlighted in the preview. */
+  focusedWindow = $state<number | null>(null);
+  /** Sequence number of the last applied update. */
+  seq = 0;
+
+  /** Applies an update from the bridge. */
+  apply(update: UiUpdate) {
+    if (update.type === "Snapshot") {
+      const ids = new Set(update.data.windows.map((w) => w.id));
+      for (const id of this.windows.keys()) {
+        if (!ids.has(id)) this.windows.delete(id);
+      }
+      for (const w of update.data.windows) this.upsert(w);
+      this.stats = update.data.stats;
+    } else {
+      for (const id of update.data.removed) this.windows.delete(id);
+      for (const w of update.data.upserted) this.upsert(w);
+      if (update.data.stats) this.stats = update.data.stats;
+    }
+    this.seq = update.data.seq;
+    this.focusedWindow = update.data.focused_window;
+  }
+
+  /** Inserts a window, or replaces it if any of its fields changed. */
+  private upsert(w: WindowInfo) {
+    const current = this.windows.get(w.id);
+    if (
+      current &&
+      current.x === w.x &&
+      current.y === w.y &&
+      current.width === w.width &&
+      current.height === w.height &&
+      current.title === w.title &&
+      current.stacked === w.stacked &&
+      current.monitor === w.monitor &&
+      current.workspace === w.workspace
+    ) {
+      return;
+    }
+    this.windows.set(w.id, w);
+  }
+}